@@ -0,0 +1,79 @@
+// Fælles for målingerne i bench_*.cpp: testposter, tidtagning og
+// kommandolinjen.
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include "weather_store.hpp"
+
+constexpr size_t bench_place_count = 100;
+
+// Post nr. i: tidspunkterne ligger 7 minutter fra hinanden, og stederne
+// "Sted 0" til "Sted 99" kommer på skift. Uden ID, som klienten sender den.
+inline weathercast_t bench_record(size_t i, std::string id = "")
+{
+    const size_t place = i % bench_place_count;
+    return weathercast_t{
+        std::move(id),
+        dateTime_t{static_cast<int64_t>(i) * 7},
+        place_t{"Sted " + std::to_string(place), 56.0 + static_cast<double>(place) / 100, 10.123},
+        static_cast<double>(i % 400) / 10 - 15,
+        static_cast<int>(i % 101)};
+}
+
+// Gennemsnitlig tid for f(i), i = 0..iterations-1, i enheden PERIOD
+template <typename PERIOD, typename F>
+double bench_average(size_t iterations, F&& f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        f(i);
+    }
+    const std::chrono::duration<double, PERIOD> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+template <typename F>
+double average_us(size_t iterations, F&& f)
+{
+    return bench_average<std::micro>(iterations, std::forward<F>(f));
+}
+
+template <typename F>
+double average_ns(size_t iterations, F&& f)
+{
+    return bench_average<std::nano>(iterations, std::forward<F>(f));
+}
+
+template <typename T>
+inline volatile T bench_sink{};
+
+// Så et resultat, der ellers ikke bruges, ikke fjernes af optimeringen
+template <typename T>
+void keep_result(T value)
+{
+    bench_sink<T> = value;
+}
+
+// Værdien af --name=N, eller fallback uden den. Andre argumenter giver
+// brugsanvisningen og afslutningskode 1.
+inline size_t bench_option(int argc, char* argv[], const std::string& name, size_t fallback)
+{
+    const std::string prefix = "--" + name + "=";
+    size_t value = fallback;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind(prefix, 0) == 0) {
+            value = std::stoull(arg.substr(prefix.size()));
+        } else {
+            std::cerr << "Brug: " << argv[0] << " [" << prefix << "N]" << std::endl;
+            std::exit(1);
+        }
+    }
+    return value;
+}
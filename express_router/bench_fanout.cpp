@@ -0,0 +1,190 @@
+// Måler udsendelsen af ændringer til mange abonnenter på /weather/live
+// gennem serverens egne klasser: ws_registry_t::route finder abonnenterne
+// under registrets lås, og send_routes lægger den delte ramme i hver
+// live_subscriber_t's kø, som sendMessage gør det. Socket'erne er
+// null_socket_t, der ikke sender noget; skrivningerne meldes færdige
+// mellem udsendelserne uden for målingen, så hver udsendelse møder en
+// forbindelse, der holder trit.
+//   alle     hver abonnent vil have alt
+//   steder   hver abonnent vil have ét af 100 steder
+//   batcher  som alle, men ændringerne går gennem live_batcher_t (uden
+//            ventetid), og målingen slutter, når rammen er lagt i køerne
+//
+//   bench_fanout [--subscribers=N]
+//
+// Antallet af abonnenter går fra 100 op til N (standard 10.000) i spring
+// på en faktor 10, med én ændring og en delta på 100 ændringer.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+
+#include "weather_store.hpp"
+#include "weather_json.hpp"
+#include "weather_live.hpp"
+#include "bench_common.hpp"
+
+namespace {
+
+constexpr size_t rounds = 50;
+
+// En socket, der husker skrivningerne og først melder dem færdige i drain
+class null_socket_t : public live_socket_t
+{
+public:
+    void send(std::shared_ptr<const std::string>, bool, written_t written) override
+    {
+        std::lock_guard lock{m_lock};
+        m_pending.push_back(std::move(written));
+    }
+
+    void kill() override {}
+
+    void drain()
+    {
+        for (;;) {
+            std::vector<written_t> pending;
+            {
+                std::lock_guard lock{m_lock};
+                pending.swap(m_pending);
+            }
+            if (pending.empty()) {
+                return;
+            }
+            for (auto& written : pending) {
+                written(true); // Kan sende den næste i køen
+            }
+        }
+    }
+
+private:
+    std::mutex m_lock;
+    std::vector<written_t> m_pending;
+};
+
+// count ændringer som fra POST /weather
+std::vector<live_change_t> make_changes(size_t count)
+{
+    std::vector<live_change_t> changes;
+    for (size_t i = 0; i < count; ++i) {
+        auto record = bench_record(i, std::to_string(i + 1));
+        auto json = std::make_shared<const std::string>(weather_to_json(record));
+        changes.push_back({true, i + 1, std::move(record), std::move(json), i + 1});
+    }
+    return changes;
+}
+
+// n abonnenter i registret; med by_place vil hver have ét sted
+struct subscribers_t
+{
+    std::vector<std::shared_ptr<null_socket_t>> m_sockets;
+    ws_registry_t m_registry;
+    std::shared_mutex m_registry_lock;
+
+    subscribers_t(size_t n, bool by_place)
+    {
+        const auto metrics = std::make_shared<ws_metrics_t>();
+        for (uint64_t id = 0; id < n; ++id) {
+            auto socket = m_sockets.emplace_back(std::make_shared<null_socket_t>());
+            m_registry.add(id, std::make_shared<live_subscriber_t>(
+                std::move(socket), 64, ws_overflow_policy_t::coalesce, metrics));
+            if (by_place) {
+                ws_subscribe_message_t subscription;
+                subscription.m_places = std::vector<std::string>{"Sted " + std::to_string(id % bench_place_count)};
+                m_registry.subscribe(id, std::move(subscription));
+            }
+        }
+    }
+
+    // Som weather_handler_t::sendMessage
+    void send(const std::vector<live_change_t>& changes)
+    {
+        std::vector<ws_registry_t::route_t> routes;
+        {
+            std::shared_lock lock{m_registry_lock};
+            routes = m_registry.route(changes);
+        }
+        const auto closed = send_routes(routes, changes, live_delta_frame);
+        if (!closed.empty()) {
+            std::cerr << closed.size() << " forbindelser lukket undervejs" << std::endl;
+        }
+    }
+
+    void drain()
+    {
+        for (const auto& socket : m_sockets) {
+            socket->drain();
+        }
+    }
+};
+
+// Gennemsnitlig tid i mikrosekunder for én udsendelse
+template <typename F>
+double fanout_us(subscribers_t& subscribers, F&& send)
+{
+    double total = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+        total += average_us(1, [&](size_t) { send(); });
+        subscribers.drain(); // Uden for målingen
+    }
+    return total / rounds;
+}
+
+double direct_us(subscribers_t& subscribers, const std::vector<live_change_t>& changes)
+{
+    return fanout_us(subscribers, [&] { subscribers.send(changes); });
+}
+
+// Fra den første ændring lægges i batcheren, til rammen er lagt i køerne
+double batched_us(subscribers_t& subscribers, const std::vector<live_change_t>& changes)
+{
+    std::mutex lock;
+    std::condition_variable sent_changed;
+    size_t sent = 0;
+    live_batcher_t batcher{std::chrono::milliseconds{0}, [&](std::vector<live_change_t> batch) {
+        subscribers.send(batch);
+        std::lock_guard guard{lock};
+        sent += batch.size();
+        sent_changed.notify_all();
+    }};
+    return fanout_us(subscribers, [&] {
+        for (const auto& change : changes) {
+            batcher.add(change);
+        }
+        std::unique_lock guard{lock};
+        sent_changed.wait(guard, [&] { return sent == changes.size(); });
+        sent = 0;
+    });
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t max_subscribers = bench_option(argc, argv, "subscribers", 10'000);
+
+    const auto single = make_changes(1);
+    const auto delta = make_changes(100);
+
+    std::printf("%12s %10s %12s %12s %14s %20s\n",
+                "abonnenter", "ændringer", "alle (us)", "steder (us)", "batcher (us)", "alle/abonnent (ns)");
+    for (size_t n = 100; n <= max_subscribers; n *= 10) {
+        subscribers_t everything{n, false};
+        subscribers_t by_place{n, true};
+
+        for (const auto* changes : {&single, &delta}) {
+            const double all = direct_us(everything, *changes);
+            const double places = direct_us(by_place, *changes);
+            const double batched = batched_us(everything, *changes);
+            std::printf("%12zu %10zu %12.1f %12.1f %14.1f %20.1f\n",
+                        n, changes->size(), all, places, batched, all * 1000 / static_cast<double>(n));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Måler indlæsning af vejrudsigter, som ved POST /weather og linjerne i
+// en NDJSON-batch: weather_from_json (den hurtige parser med json_dto som
+// reserve) mod json_dto::from_json<weathercast_t>. Tjekker også, at de
+// giver de samme poster.
+//
+//   bench_ingest [--records=N]
+//
+// Der parses N forskellige kroppe (standard 100.000), både kompakte som
+// fra client.js og med mellemrum og linjeskift.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdio>
+
+#include "weather_store.hpp"
+#include "weather_json.hpp"
+#include "bench_common.hpp"
+
+namespace {
+
+// Samme krop med mellemrum efter , og : og et linjeskift pr. felt
+std::string spaced_body(const std::string& compact)
+{
+    std::string out;
+    bool in_string = false;
+    for (size_t i = 0; i < compact.size(); ++i) {
+        const char c = compact[i];
+        out += c;
+        if (c == '"' && (i == 0 || compact[i - 1] != '\\')) {
+            in_string = !in_string;
+        } else if (!in_string && c == ',') {
+            out += "\n  ";
+        } else if (!in_string && c == ':') {
+            out += ' ';
+        }
+    }
+    return out;
+}
+
+// Gennemsnitlig tid i nanosekunder pr. krop for parse(krop)
+template <typename F>
+double parse_ns(const std::vector<std::string>& bodies, double& checksum, F&& parse)
+{
+    return average_ns(bodies.size(), [&](size_t i) { checksum += parse(bodies[i]).m_temperature; });
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t count = bench_option(argc, argv, "records", 100'000);
+
+    std::vector<std::string> compact;
+    std::vector<std::string> spaced;
+    for (size_t i = 0; i < count; ++i) {
+        compact.push_back(weather_to_json(bench_record(i))); // Som client.js sender den
+        spaced.push_back(spaced_body(compact.back()));
+    }
+
+    for (const auto* bodies : {&compact, &spaced}) {
+        for (const auto& body : *bodies) {
+            if (weather_to_json(weather_from_json(body)) !=
+                weather_to_json(json_dto::from_json<weathercast_t>(body))) {
+                std::cerr << "Parserne er uenige om: " << body << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    double checksum = 0;
+    std::printf("%-12s %12s %16s %16s %14s\n", "krop", "bytes", "json_dto (ns)", "hurtig (ns)", "hurtig (MB/s)");
+    for (const auto& [name, bodies] : {std::pair{"kompakt", &compact}, std::pair{"mellemrum", &spaced}}) {
+        size_t bytes = 0;
+        for (const auto& body : *bodies) {
+            bytes += body.size();
+        }
+        const double dto = parse_ns(*bodies, checksum, [](const std::string& body) {
+            return json_dto::from_json<weathercast_t>(body);
+        });
+        const double fast = parse_ns(*bodies, checksum, [](const std::string& body) {
+            return weather_from_json(body);
+        });
+        const double average = static_cast<double>(bytes) / static_cast<double>(bodies->size());
+        std::printf("%-12s %12.0f %16.0f %16.0f %14.0f\n", name, average, dto, fast, average * 1000 / fast);
+    }
+    keep_result(checksum);
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Sammenligner JSON-skriveren i weather_json.hpp med json_dto::to_json,
+// for én post (som svaret på GET /weather/:id og POST) og for et array af
+// poster (som GET /weather). Tjekker også, at de giver de samme bytes.
+//
+//   bench_json [--records=N]
+//
+// Arrayet har N poster (standard 100.000).
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "weather_store.hpp"
+#include "weather_json.hpp"
+#include "bench_common.hpp"
+
+namespace {
+
+// Posterne med ID'er, som i lageret
+std::vector<weathercast_t> make_records(size_t n)
+{
+    std::vector<weathercast_t> records;
+    records.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        records.push_back(bench_record(i, std::to_string(i + 1)));
+    }
+    return records;
+}
+
+// Gennemsnitlig tid i mikrosekunder for f(), hvis resultat lægges i bytes
+template <typename F>
+double serialize_us(size_t iterations, size_t& bytes, F&& f)
+{
+    return average_us(iterations, [&](size_t) { bytes += f().size(); });
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t count = bench_option(argc, argv, "records", 100'000);
+
+    const auto records = make_records(count);
+    if (weather_to_json(records) != json_dto::to_json(records)) {
+        std::cerr << "Skriveren giver ikke de samme bytes som json_dto::to_json" << std::endl;
+        return 1;
+    }
+
+    size_t bytes = 0;
+    const auto& record = records[count / 2];
+    const double single_dto = serialize_us(200'000, bytes, [&] { return json_dto::to_json(record); });
+    const double single_writer = serialize_us(200'000, bytes, [&] { return weather_to_json(record); });
+    std::string buffer;
+    const double single_reused = serialize_us(200'000, bytes, [&]() -> const std::string& {
+        buffer.clear();
+        append_weather_json(buffer, record); // Samme buffer hver gang
+        return buffer;
+    });
+
+    const double array_dto = serialize_us(10, bytes, [&] { return json_dto::to_json(records); });
+    const double array_writer = serialize_us(10, bytes, [&] { return weather_to_json(records); });
+
+    std::printf("%-28s %16s %16s %16s\n", "", "json_dto (us)", "skriver (us)", "genbrugt (us)");
+    std::printf("%-28s %16.3f %16.3f %16.3f\n", "1 post", single_dto, single_writer, single_reused);
+    std::printf("%-28s %16.1f %16.1f %16s\n", (std::to_string(count) + " poster").c_str(), array_dto, array_writer, "-");
+    keep_result(bytes);
+    return 0;
+}
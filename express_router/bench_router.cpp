@@ -0,0 +1,198 @@
+// Måler hvad det koster at finde ruten til en forespørgsel, med den faste
+// rutetabel (static_router_t) og med restinio's express_router_t, som
+// serveren brugte før, med de samme mønstre og regulære udtryk. Handlerne
+// læser kun parametrene, så det er routingen der måles.
+//
+//   bench_router [--iterations=N]
+//
+// Hver sti i tabellen herunder sendes N gange (standard 1.000.000).
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <utility>
+#include <cstdio>
+#include <restinio/all.hpp>
+
+#include "static_router.hpp"
+#include "bench_common.hpp"
+
+namespace rr = restinio::router;
+
+// Handleren til den faste tabel; tæller parametrenes længde (se
+// keep_result)
+struct bench_handler_t
+{
+    size_t m_checksum = 0;
+
+    restinio::request_handling_status_t on_plain(const restinio::request_handle_t&, const static_route_params_t&)
+    {
+        ++m_checksum;
+        return restinio::request_accepted();
+    }
+
+    restinio::request_handling_status_t on_id(const restinio::request_handle_t&, const static_route_params_t& params)
+    {
+        m_checksum += params["id"].size();
+        return restinio::request_accepted();
+    }
+
+    restinio::request_handling_status_t on_date(const restinio::request_handle_t&, const static_route_params_t& params)
+    {
+        m_checksum += params["date"].size();
+        return restinio::request_accepted();
+    }
+
+    restinio::request_handling_status_t on_range(const restinio::request_handle_t&, const static_route_params_t& params)
+    {
+        m_checksum += params["from"].size() + params["to"].size();
+        return restinio::request_accepted();
+    }
+
+    restinio::request_handling_status_t on_name(const restinio::request_handle_t&, const static_route_params_t& params)
+    {
+        m_checksum += params["name"].size();
+        return restinio::request_accepted();
+    }
+
+    restinio::request_handling_status_t on_n(const restinio::request_handle_t&, const static_route_params_t& params)
+    {
+        m_checksum += params["n"].size();
+        return restinio::request_accepted();
+    }
+};
+
+template <auto METHOD>
+constexpr auto call = call_route<bench_handler_t, METHOD>;
+
+// Samme ruter i samme rækkefølge som weather_routes i main.cpp
+constexpr std::array<static_route_t<bench_handler_t>, 17> bench_routes{{
+    {route_method_t::options, "/weather", call<&bench_handler_t::on_plain>},
+    {route_method_t::options, "/weather/batch", call<&bench_handler_t::on_plain>},
+    {route_method_t::options, "/weather/:id(number)", call<&bench_handler_t::on_id>},
+    {route_method_t::options, "/weather/live", call<&bench_handler_t::on_plain>},
+    {route_method_t::get, "/weather", call<&bench_handler_t::on_plain>},
+    {route_method_t::get, "/", call<&bench_handler_t::on_plain>},
+    {route_method_t::get, "/metrics", call<&bench_handler_t::on_plain>},
+    {route_method_t::get, "/weather/:id(number)", call<&bench_handler_t::on_id>},
+    {route_method_t::get, "/weather/date/:date(date)", call<&bench_handler_t::on_date>},
+    {route_method_t::get, "/weather/range/:from(date)/:to(date)", call<&bench_handler_t::on_range>},
+    {route_method_t::get, "/weather/place/:name", call<&bench_handler_t::on_name>},
+    {route_method_t::get, "/weather/latest_three", call<&bench_handler_t::on_plain>},
+    {route_method_t::get, "/weather/latest/:n(number)", call<&bench_handler_t::on_n>},
+    {route_method_t::post, "/weather", call<&bench_handler_t::on_plain>},
+    {route_method_t::post, "/weather/batch", call<&bench_handler_t::on_plain>},
+    {route_method_t::put, "/weather/:id(number)", call<&bench_handler_t::on_id>},
+    {route_method_t::get, "/weather/live", call<&bench_handler_t::on_plain>},
+}};
+
+restinio::request_handling_status_t not_handled(const restinio::request_handle_t&)
+{
+    return restinio::request_rejected();
+}
+
+std::unique_ptr<static_router_t<bench_handler_t>> make_static_router(std::shared_ptr<bench_handler_t> handler)
+{
+    return std::make_unique<static_router_t<bench_handler_t>>(std::move(handler), bench_routes, not_handled, not_handled);
+}
+
+// Ruterne som server_handler registrerede dem på express_router_t
+std::unique_ptr<rr::express_router_t<>> make_express_router(size_t& checksum)
+{
+    auto router = std::make_unique<rr::express_router_t<>>();
+    auto plain = [&checksum](const restinio::request_handle_t&, rr::route_params_t) {
+        ++checksum;
+        return restinio::request_accepted();
+    };
+    auto param = [&checksum](auto... names) {
+        return [&checksum, names...](const restinio::request_handle_t&, rr::route_params_t params) {
+            checksum += (params[names].size() + ...);
+            return restinio::request_accepted();
+        };
+    };
+
+    router->add_handler(restinio::http_method_options(), "/weather", plain);
+    router->add_handler(restinio::http_method_options(), "/weather/batch", plain);
+    router->add_handler(restinio::http_method_options(), R"(/weather/:id([0-9]+))", param("id"));
+    router->add_handler(restinio::http_method_options(), "/weather/live", plain);
+    router->http_get("/weather", plain);
+    router->http_get("/", plain);
+    router->http_get("/metrics", plain);
+    router->http_get(R"(/weather/:id([0-9]+))", param("id"));
+    router->http_get(R"(/weather/date/:date([0-9]{8}))", param("date"));
+    router->http_get(R"(/weather/range/:from([0-9]{8})/:to([0-9]{8}))", param("from", "to"));
+    router->http_get(R"(/weather/place/:name([^/]+))", param("name"));
+    router->http_get("/weather/latest_three", plain);
+    router->http_get(R"(/weather/latest/:n([0-9]+))", param("n"));
+    router->http_post("/weather", plain);
+    router->http_post("/weather/batch", plain);
+    router->http_put(R"(/weather/:id([0-9]+))", param("id"));
+    router->http_get("/weather/live", plain);
+    router->add_handler(restinio::router::none_of_methods(), ".*", [](const restinio::request_handle_t&, auto) {
+        return restinio::request_rejected();
+    });
+    router->non_matched_request_handler([](const restinio::request_handle_t&) {
+        return restinio::request_rejected();
+    });
+    return router;
+}
+
+// En forespørgsel uden forbindelse; handlerne svarer ikke på den
+restinio::request_handle_t make_request(restinio::http_method_id_t method, std::string target)
+{
+    return std::make_shared<restinio::request_t>(
+        restinio::request_id_t{1},
+        restinio::http_request_header_t{method, std::move(target)},
+        std::string{},
+        restinio::impl::connection_handle_t{},
+        restinio::endpoint_t{});
+}
+
+// Gennemsnitlig tid i nanosekunder for router(req)
+template <typename ROUTER>
+double route_ns(ROUTER& router, const restinio::request_handle_t& req, size_t iterations)
+{
+    return average_ns(iterations, [&](size_t) { router(req); });
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t iterations = bench_option(argc, argv, "iterations", 1'000'000);
+
+    const std::vector<std::pair<restinio::http_method_id_t, std::string>> requests{
+        {restinio::http_method_get(), "/weather"},
+        {restinio::http_method_get(), "/weather/123456"},
+        {restinio::http_method_get(), "/weather/date/20240315"},
+        {restinio::http_method_get(), "/weather/range/20240301/20240331"},
+        {restinio::http_method_get(), "/weather/place/Aarhus"},
+        {restinio::http_method_get(), "/weather/latest/10"},
+        {restinio::http_method_get(), "/weather/live"},
+        {restinio::http_method_post(), "/weather"},
+        {restinio::http_method_put(), "/weather/42"},
+        {restinio::http_method_get(), "/findes/ikke"},
+    };
+
+    auto handler = std::make_shared<bench_handler_t>();
+    auto fixed = make_static_router(handler);
+    size_t express_checksum = 0;
+    auto express = make_express_router(express_checksum);
+
+    std::printf("%-36s %16s %16s\n", "sti", "fast tabel (ns)", "express (ns)");
+    double fixed_total = 0;
+    double express_total = 0;
+    for (const auto& [method, target] : requests) {
+        const auto req = make_request(method, target);
+        const double fixed_ns = route_ns(*fixed, req, iterations);
+        const double express_ns = route_ns(*express, req, iterations);
+        fixed_total += fixed_ns;
+        express_total += express_ns;
+        const std::string label = std::string{method.c_str()} + " " + target;
+        std::printf("%-36s %16.1f %16.1f\n", label.c_str(), fixed_ns, express_ns);
+    }
+    const auto count = static_cast<double>(requests.size());
+    std::printf("%-36s %16.1f %16.1f\n", "gennemsnit", fixed_total / count, express_total / count);
+
+    keep_result(handler->m_checksum + express_checksum);
+    return 0;
+}
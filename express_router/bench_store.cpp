@@ -0,0 +1,120 @@
+// Måler opslag og skrivninger i weather_store_t ved voksende
+// lagerstørrelse, som serveren udfører dem: opslag på ID (GET /weather/:id),
+// og kopi af den udgivne version efterfulgt af en opdatering på ID (PUT),
+// tjek for dublerede tidspunkter og indsættelse (POST) eller en hel batch
+// (POST /weather/batch).
+//
+//   bench_store [--max=N]
+//
+// Lagrene bygges med bulk_load fra 1.000 poster og op til N (standard
+// 10.000.000) i spring på en faktor 10, med 100 steder på skift.
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <cstdio>
+
+#include "weather_store.hpp"
+#include "bench_common.hpp"
+
+namespace {
+
+// Lager med n poster (se bench_record)
+std::shared_ptr<const weather_store_t> make_store(size_t n)
+{
+    std::vector<weathercast_t> records;
+    records.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        records.push_back(bench_record(i));
+    }
+    std::vector<std::pair<size_t, std::string>> rejected;
+    return std::make_shared<const weather_store_t>(weather_store_t::bulk_load(std::move(records), rejected));
+}
+
+// GET /weather/:id på tilfældige ID'er
+double get_by_id_us(const weather_store_t& store)
+{
+    std::mt19937_64 random{42};
+    std::uniform_int_distribution<uint64_t> ids{1, store.size()};
+    double checksum = 0;
+    const double result = average_us(200'000, [&](size_t) {
+        checksum += store.find_by_id(ids(random))->m_temperature;
+    });
+    keep_result(checksum);
+    return result;
+}
+
+// PUT /weather/:id: kopi og opdatering af en tilfældig post
+double put_us(std::shared_ptr<const weather_store_t> current)
+{
+    std::mt19937_64 random{43};
+    std::uniform_int_distribution<uint64_t> ids{1, current->size()};
+    return average_us(2000, [&](size_t i) {
+        auto next = std::make_shared<weather_store_t>(*current);
+        const uint64_t id = ids(random);
+        auto record = *next->find_by_id(id);
+        record.m_temperature = static_cast<double>(i);
+        next->update(id, record);
+        current = std::move(next);
+    });
+}
+
+// POST: kopi, dublettjek og indsættelse; den nye version erstatter den
+// gamle, så frigivelsen også tælles med
+double post_us(std::shared_ptr<const weather_store_t> current)
+{
+    size_t next_record = current->size();
+    return average_us(2000, [&](size_t) {
+        auto next = std::make_shared<weather_store_t>(*current);
+        auto record = bench_record(next_record++);
+        if (!next->contains_time(record.m_dateTime)) {
+            next->insert(std::move(record));
+        }
+        current = std::move(next);
+    });
+}
+
+// POST /weather/batch med batch_size poster
+double batch_us(std::shared_ptr<const weather_store_t> current, size_t batch_size)
+{
+    // Posterne laves på forhånd, så kun lageret måles
+    constexpr size_t batches = 20;
+    size_t next_record = current->size();
+    std::vector<std::vector<weathercast_t>> input(batches);
+    for (auto& batch : input) {
+        for (size_t k = 0; k < batch_size; ++k) {
+            batch.push_back(bench_record(next_record++));
+        }
+    }
+
+    return average_us(batches, [&](size_t i) {
+        auto next = std::make_shared<weather_store_t>(*current);
+        std::vector<weathercast_t> accepted;
+        for (auto& record : input[i]) {
+            if (!next->contains_time(record.m_dateTime)) {
+                accepted.push_back(std::move(record));
+            }
+        }
+        next->insert_batch(std::move(accepted));
+        current = std::move(next);
+    });
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t max_records = bench_option(argc, argv, "max", 10'000'000);
+
+    std::printf("%12s %12s %12s %12s %16s\n", "poster", "GET id (us)", "PUT (us)", "POST (us)", "batch 1000 (us)");
+    for (size_t n = 1000; n <= max_records; n *= 10) {
+        const auto store = make_store(n);
+        const double get = get_by_id_us(*store);
+        const double put = put_us(store);
+        const double post = post_us(store);
+        const double batch = batch_us(store, 1000);
+        std::printf("%12zu %12.3f %12.2f %12.2f %16.1f\n", n, get, put, post, batch);
+    }
+    return 0;
+}
@@ -2,12 +2,19 @@ const API_BASE_URL = 'http://localhost:8080';
 const WS_URL = 'ws://localhost:8080/weather/live';
 let weatherTable;
 let ws;
+// Løbenummeret på den seneste ændring i tabellen og serverkørslen det hører til
+let lastSeq;
+let epoch;
+// Delta-rammer der kommer mens hele datasættet hentes, anvendes bagefter
+let loadingAll = false;
+let pendingDeltas = [];
 
 // Funktion til at initialisere Tabulator-tabellen
 function initializeTable() {
     if (!weatherTable) {
         weatherTable = new Tabulator("#weatherDataTable", {
             layout: "fitDataFill",
+            index: "ID",
             height: "auto",
             columns: [
                 { title: "ID", field: "ID", width: 60 },
@@ -31,19 +38,31 @@ function connectWebSocket() {
 
     ws.onopen = () => {
         console.log('WebSocket-forbindelse oprettet.');
+        requestResync();
     };
 
     ws.onmessage = (event) => {
         console.log('Modtaget besked fra WebSocket:', event.data);
+        let message;
         try {
-            const message = JSON.parse(event.data);
-            if (message && (message.ID || message.type === 'weather_updated' || message.type === 'weather_created')) {
-                console.log('Vejrdata ændret via WebSocket. Opdaterer tabel...');
-                getAllWeatherData(); 
-            }
+            message = JSON.parse(event.data);
         } catch (e) {
-            console.warn('Kunne ikke parse WebSocket-besked som JSON, men genopfrisker alligevel:', event.data);
-            getAllWeatherData();
+            console.warn('Kunne ikke parse WebSocket-besked som JSON:', event.data);
+            return;
+        }
+        if (message.type === 'weather_delta') {
+            if (loadingAll) {
+                pendingDeltas.push(message);
+            } else {
+                applyDelta(message);
+            }
+        } else if (message.type === 'resync_required') {
+            // Serveren husker ikke længere så langt tilbage; hent alt og fortsæt fra message.seq
+            epoch = message.epoch;
+            loadAllFrom(message.seq);
+        } else if (message.type === 'lagged') {
+            // Serveren har smidt ændringer væk til os; bed om dem igen
+            requestResync();
         }
     };
 
@@ -61,11 +80,39 @@ function connectWebSocket() {
 
 document.addEventListener('DOMContentLoaded', () => {
     initializeTable();
+    // Alle data hentes, når serveren svarer på den første resync
     connectWebSocket();
-    // Hent alle data ved start
-    getAllWeatherData();
 });
 
+// Beder om ændringerne siden lastSeq (eller om at hente alt, hvis vi ingen har)
+function requestResync() {
+    ws.send(JSON.stringify({ type: 'resync', since: lastSeq, epoch: epoch }));
+}
+
+// Indfører oprettede og ændrede poster i tabellen efter ID. Et svar på en
+// resync anvendes altid: rammer sendt efter "lagged" kan have et højere seq
+// end de ændringer, der blev smidt væk, og som svaret indeholder
+function applyDelta(message) {
+    if (!message.resync && lastSeq !== undefined && message.seq <= lastSeq) {
+        return; // Allerede med
+    }
+    weatherTable.updateOrAddData(message.created.concat(message.updated));
+    if (lastSeq === undefined || message.seq > lastSeq) {
+        lastSeq = message.seq;
+    }
+}
+
+async function loadAllFrom(seq) {
+    loadingAll = true;
+    await getAllWeatherData();
+    lastSeq = seq;
+    loadingAll = false;
+    // Resync-svar, som de hentede data allerede dækker, springes over
+    const deltas = pendingDeltas.filter((message) => !message.resync || message.seq > seq);
+    pendingDeltas = [];
+    deltas.forEach(applyDelta);
+}
+
 
 // HTTP GET funktionalitet
 async function getAllWeatherData() {
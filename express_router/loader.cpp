@@ -0,0 +1,322 @@
+// Indlæser vejrdata fra CSV- eller NDJSON-filer og skriver en snapshot-fil,
+// som serveren kan mmap'e ved start (main --snapshot=FIL).
+//
+//   loader [--threads=N] [--wal=LOG] UDFIL INDFIL...
+//
+// Filer der ender på .csv læses som CSV med kolonnerne
+//   ID,Dato,Klokkeslæt,Sted,Lat,Lon,Temperatur,Luftfugtighed
+// (ID må være tomt; en første linje der starter med "ID" er en overskrift,
+// og felter kan stå i anførselstegn). Alle andre filer læses som NDJSON
+// med én vejrudsigt pr. linje i samme format som GET /weather.
+//
+// Hver fil deles i lige store bidder ved linjeskift, og bidderne parses
+// på hver sin tråd. Posterne indsættes derefter i filernes rækkefølge.
+// Snapshottet skrives med de gyldige poster, men afslutningskoden er 1,
+// hvis en linje ikke kunne læses eller en post blev afvist.
+//
+// Snapshottet dækker ingen log (logposition 0), så en server, der starter
+// med en gammel --wal, ville afspille hele den gamle log oven i det og
+// støde på dens ID'er. Med --wal=LOG (serverens log) flyttes loggen derfor
+// til LOG.old, før snapshottet skrives, og serveren starter på en tom log.
+// Uden --wal nægter indlæseren at overskrive en eksisterende UDFIL, da der
+// så kan ligge en log bag den.
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <charconv>
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+#include "weather_store.hpp"
+#include "weather_json.hpp"
+
+// Resultatet af at parse én bid af en fil
+struct chunk_result_t
+{
+    std::vector<weathercast_t> m_records;
+    std::vector<size_t> m_record_lines; // Linje i bidden for hver post
+    std::vector<std::pair<size_t, std::string>> m_errors; // (linje i bidden, årsag)
+    size_t m_lines = 0;
+};
+
+// Hvor en post kom fra, så en afvisning i bulk_load kan spores
+struct record_source_t
+{
+    const std::string* m_path;
+    size_t m_line; // Fra 1
+};
+
+// Et felt i en CSV-linje; fjerner anførselstegn og "" inde i dem
+std::string_view next_csv_field(std::string_view& line, std::string& unquoted)
+{
+    if (!line.empty() && line.front() == '"') {
+        unquoted.clear();
+        size_t i = 1;
+        for (; i < line.size(); ++i) {
+            if (line[i] == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    unquoted += '"';
+                    ++i;
+                    continue;
+                }
+                break;
+            }
+            unquoted += line[i];
+        }
+        if (i >= line.size()) {
+            throw std::invalid_argument("Manglende afsluttende anførselstegn");
+        }
+        if (i + 1 < line.size() && line[i + 1] != ',') {
+            throw std::invalid_argument("Tegn efter afsluttende anførselstegn");
+        }
+        line.remove_prefix(std::min(line.size(), i + 2)); // Efter " og komma
+        return unquoted;
+    }
+    const auto comma = line.find(',');
+    const auto field = line.substr(0, comma);
+    line = comma == std::string_view::npos ? std::string_view{} : line.substr(comma + 1);
+    return field;
+}
+
+template <typename T>
+T parse_number(std::string_view field, const char* what)
+{
+    T value{};
+    const auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (error != std::errc{} || end != field.data() + field.size()) {
+        throw std::invalid_argument(std::string("Ugyldig ") + what + ": " + std::string(field));
+    }
+    return value;
+}
+
+weathercast_t parse_csv_line(std::string_view line)
+{
+    std::string quoted;
+    weathercast_t record;
+    record.m_id = std::string(next_csv_field(line, quoted));
+    const std::string date{next_csv_field(line, quoted)};
+    const std::string time{next_csv_field(line, quoted)};
+    record.m_dateTime = dateTime_t{date, time};
+    record.m_place.m_name = std::string(next_csv_field(line, quoted));
+    record.m_place.m_lat = parse_number<double>(next_csv_field(line, quoted), "breddegrad");
+    record.m_place.m_lon = parse_number<double>(next_csv_field(line, quoted), "længdegrad");
+    record.m_temperature = parse_number<double>(next_csv_field(line, quoted), "temperatur");
+    record.m_humidity = parse_number<int>(next_csv_field(line, quoted), "luftfugtighed");
+    if (!line.empty()) {
+        throw std::invalid_argument("For mange felter");
+    }
+    return record;
+}
+
+// NaN og uendelig kan ikke skrives som JSON, så de afvises her, før de
+// havner i snapshottet (from_chars accepterer "nan", "inf" og "infinity")
+void check_finite(const weathercast_t& record)
+{
+    if (!std::isfinite(record.m_place.m_lat) || !std::isfinite(record.m_place.m_lon)) {
+        throw std::invalid_argument("Koordinaterne skal være endelige tal");
+    }
+    if (!std::isfinite(record.m_temperature)) {
+        throw std::invalid_argument("Temperaturen skal være et endeligt tal");
+    }
+}
+
+chunk_result_t parse_chunk(std::string_view chunk, bool csv, bool first_chunk)
+{
+    chunk_result_t result;
+    while (!chunk.empty()) {
+        const auto end = chunk.find('\n');
+        std::string_view line = chunk.substr(0, end);
+        chunk = end == std::string_view::npos ? std::string_view{} : chunk.substr(end + 1);
+        const size_t line_number = result.m_lines++;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") == std::string_view::npos) {
+            continue;
+        }
+        if (csv && first_chunk && line_number == 0 && line.substr(0, 2) == "ID") {
+            continue; // Overskrift
+        }
+        try {
+            weathercast_t record = csv ? parse_csv_line(line) : weather_from_json(line);
+            check_finite(record);
+            result.m_records.push_back(std::move(record));
+            result.m_record_lines.push_back(line_number);
+        } catch (const std::exception& ex) {
+            result.m_errors.emplace_back(line_number, ex.what());
+        }
+    }
+    return result;
+}
+
+// Læser en hel fil ind i hukommelsen
+std::string read_file(const std::string& path)
+{
+    FILE* in = std::fopen(path.c_str(), "rb");
+    if (!in) {
+        throw std::runtime_error("Kan ikke åbne " + path + ": " + std::strerror(errno));
+    }
+    std::string data;
+    char buffer[1 << 16];
+    size_t n = 0;
+    while ((n = std::fread(buffer, 1, sizeof buffer, in)) > 0) {
+        data.append(buffer, n);
+    }
+    const bool failed = std::ferror(in) != 0;
+    std::fclose(in);
+    if (failed) {
+        throw std::runtime_error("Kan ikke læse " + path);
+    }
+    return data;
+}
+
+// Parser en fil på threads tråde og lægger posterne i records og deres
+// oprindelse i sources
+void load_file(
+    const std::string& path,
+    size_t threads,
+    std::vector<weathercast_t>& records,
+    std::vector<record_source_t>& sources,
+    size_t& errors)
+{
+    const std::string data = read_file(path);
+    const bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+
+    // Bidder der starter lige efter et linjeskift
+    std::vector<std::string_view> chunks;
+    size_t start = 0;
+    for (size_t i = 1; i <= threads && start < data.size(); ++i) {
+        const size_t newline = data.find('\n', std::max(data.size() * i / threads, start));
+        const size_t end = newline == std::string::npos ? data.size() : newline + 1;
+        chunks.emplace_back(data.data() + start, end - start);
+        start = end;
+    }
+
+    std::vector<chunk_result_t> results(chunks.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        workers.emplace_back([&, i] { results[i] = parse_chunk(chunks[i], csv, i == 0); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    size_t first_line = 1;
+    for (auto& result : results) {
+        for (const auto& [line, error] : result.m_errors) {
+            std::cerr << path << ":" << first_line + line << ": " << error << std::endl;
+        }
+        errors += result.m_errors.size();
+        for (const size_t line : result.m_record_lines) {
+            sources.push_back({&path, first_line + line});
+        }
+        first_line += result.m_lines;
+        std::move(result.m_records.begin(), result.m_records.end(), std::back_inserter(records));
+    }
+}
+
+std::optional<std::string_view> option_value(std::string_view arg, std::string_view name)
+{
+    if (arg.size() > name.size() && arg.substr(0, name.size()) == name &&
+        arg[name.size()] == '=') {
+        return arg.substr(name.size() + 1);
+    }
+    return std::nullopt;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace std::chrono;
+
+    try
+    {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string wal_path;
+        std::vector<std::string> files;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg{argv[i]};
+            if (const auto value = option_value(arg, "--threads")) {
+                threads = std::max<size_t>(1, std::stoul(std::string(*value)));
+            } else if (const auto value = option_value(arg, "--wal")) {
+                wal_path = std::string(*value);
+            } else if (arg.substr(0, 2) == "--") {
+                throw std::invalid_argument("Ukendt parameter: " + std::string(arg));
+            } else {
+                files.emplace_back(arg);
+            }
+        }
+        if (files.size() < 2) {
+            std::cerr << "Brug: " << argv[0] << " [--threads=N] [--wal=LOG] UDFIL INDFIL..." << std::endl;
+            return 2;
+        }
+        const std::string old_wal_path = wal_path + ".old";
+        if (wal_path.empty() && ::access(files[0].c_str(), F_OK) == 0) {
+            throw std::runtime_error(files[0] + " findes allerede. Angiv serverens log med --wal=LOG, så den "
+                                     "flyttes til side, eller slet filen først.");
+        }
+        if (!wal_path.empty() && ::access(wal_path.c_str(), F_OK) == 0 && ::access(old_wal_path.c_str(), F_OK) == 0) {
+            throw std::runtime_error(old_wal_path + " findes allerede og ville blive overskrevet");
+        }
+
+        const auto started = steady_clock::now();
+        std::vector<weathercast_t> records;
+        std::vector<record_source_t> sources;
+        size_t errors = 0;
+        for (size_t i = 1; i < files.size(); ++i) {
+            load_file(files[i], threads, records, sources, errors);
+        }
+        const size_t parsed = records.size();
+        const auto parsed_at = steady_clock::now();
+
+        std::vector<std::pair<size_t, std::string>> rejected;
+        const weather_store_t store = weather_store_t::bulk_load(std::move(records), rejected);
+        for (const auto& [index, reason] : rejected) {
+            const auto& source = sources[index];
+            std::cerr << *source.m_path << ":" << source.m_line << ": afvist: " << reason << std::endl;
+        }
+        const bool wal_moved = !wal_path.empty() && ::access(wal_path.c_str(), F_OK) == 0;
+        if (wal_moved) {
+            if (::rename(wal_path.c_str(), old_wal_path.c_str()) != 0) {
+                throw std::runtime_error("Kan ikke omdøbe " + wal_path + ": " + strerror(errno));
+            }
+            sync_parent_directory(wal_path);
+        }
+        store.save_snapshot(files[0], 0);
+        const auto done_at = steady_clock::now();
+
+        std::cout << "Parsede " << parsed << " poster (" << errors << " fejl) på "
+                  << duration_cast<milliseconds>(parsed_at - started).count() << " ms, skrev "
+                  << store.size() << " poster (" << rejected.size() << " afvist) til " << files[0]
+                  << " på " << duration_cast<milliseconds>(done_at - parsed_at).count() << " ms" << std::endl;
+        if (wal_moved) {
+            std::cout << "Loggen " << wal_path << " er flyttet til " << old_wal_path << std::endl;
+        }
+        std::cout << "Start serveren med --snapshot=" << files[0];
+        if (wal_path.empty()) {
+            std::cout << " (og uden en gammel --wal-fil, da snapshottet erstatter den)";
+        }
+        std::cout << std::endl;
+        if (errors != 0 || !rejected.empty()) {
+            std::cerr << errors + rejected.size() << " poster kom ikke med (se ovenfor)" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Fejl: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -5,156 +5,598 @@
 #include <json_dto/pub.hpp>
 #include <restinio/websocket/websocket.hpp>
 #include <chrono>    
+#include <optional>
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <unordered_set>
+#include <set>
+#include <deque>
+#include <numeric>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "weather_store.hpp"
+#include "weather_json.hpp"
+#include "weather_columns.hpp"
+#include "weather_live.hpp"
+#include "write_ahead_log.hpp"
+#include "static_router.hpp"
 
 using namespace std; // Skabte problemer
 
-// Definition af strukturen for Sted (Place)
-struct place_t
+// Måletal for baggrundsgemningen, vist på /metrics
+struct persistence_metrics_t
 {
-    string m_name; // Navn
-    double m_lat;  // Lat
-    double m_lon;  // Lon
+    atomic<uint64_t> m_snapshots{0};
+    atomic<uint64_t> m_failures{0};
+    atomic<uint64_t> m_last_records{0};
+    atomic<uint64_t> m_last_duration_us{0};
+    atomic<uint64_t> m_max_duration_us{0};
+    // Hvor længe skrivere holdes tilbage, mens versionen og LSN aflæses
+    atomic<uint64_t> m_last_pause_us{0};
+    atomic<uint64_t> m_max_pause_us{0};
+};
+
+// Baggrundstråd der med fast interval gemmer et snapshot af lageret og
+// derefter fjerner de dækkede poster fra loggen. Snapshottet er en
+// uforanderlig version, så selve skrivningen sker uden nogen lås;
+// forespørgsler mærker kun den korte aflæsning under skrivelåsen.
+class snapshot_writer_t
+{
+public:
+    snapshot_writer_t(
+        shared_weather_store_t& store,
+        write_ahead_log_t* wal,
+        string path,
+        chrono::seconds interval,
+        persistence_metrics_t& metrics)
+        : m_store(store)
+        , m_wal(wal)
+        , m_path(move(path))
+        , m_interval(interval)
+        , m_metrics(metrics)
+        , m_saved_version(store.snapshot()->version())
+        , m_thread([this] { run(); })
+    {}
+
+    snapshot_writer_t(const snapshot_writer_t&) = delete;
+    snapshot_writer_t& operator=(const snapshot_writer_t&) = delete;
+
+    ~snapshot_writer_t()
+    {
+        {
+            lock_guard lock{m_lock};
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+private:
+    shared_weather_store_t& m_store;
+    write_ahead_log_t* const m_wal; // nullptr hvis serveren kører uden log
+    const string m_path;
+    const chrono::seconds m_interval;
+    persistence_metrics_t& m_metrics;
+    uint64_t m_saved_version; // Kun brugt af tråden
+
+    mutex m_lock;
+    condition_variable m_wake;
+    bool m_stop = false;
+    thread m_thread; // Sidst, så den startes efter resten er klar
+
+    void run()
+    {
+        unique_lock lock{m_lock};
+        while (!m_wake.wait_for(lock, m_interval, [&] { return m_stop; })) {
+            lock.unlock();
+            save();
+            lock.lock();
+        }
+    }
+
+    void save()
+    {
+        using namespace chrono;
+        const auto started = steady_clock::now();
+
+        // Versionen og loggens LSN skal høre sammen, så de aflæses under skrivelåsen
+        steady_clock::duration pause{};
+        const auto [snapshot, lsn] = m_store.read_locked([&](const shared_weather_store_t::snapshot_t& current) {
+            const auto locked = steady_clock::now();
+            const auto result = make_pair(current, m_wal ? m_wal->last_lsn() : 0);
+            pause = steady_clock::now() - locked;
+            return result;
+        });
+        record_max(m_metrics.m_last_pause_us, m_metrics.m_max_pause_us,
+                   duration_cast<microseconds>(pause).count());
+
+        if (snapshot->version() == m_saved_version) {
+            return; // Intet nyt siden sidst
+        }
+        try {
+            snapshot->save_snapshot(m_path, lsn);
+            if (m_wal) {
+                m_wal->compact(lsn);
+            }
+            m_saved_version = snapshot->version();
+            ++m_metrics.m_snapshots;
+            m_metrics.m_last_records = snapshot->size();
+        } catch (const exception& ex) {
+            ++m_metrics.m_failures;
+            cerr << "Fejl ved gemning af snapshot: " << ex.what() << endl;
+        }
+        record_max(m_metrics.m_last_duration_us, m_metrics.m_max_duration_us,
+                   duration_cast<microseconds>(steady_clock::now() - started).count());
+    }
+
+    static void record_max(atomic<uint64_t>& last, atomic<uint64_t>& max_seen, int64_t value)
+    {
+        const auto us = static_cast<uint64_t>(value);
+        last = us;
+        if (us > max_seen) {
+            max_seen = us; // Kun én tråd skriver, så ingen compare-exchange
+        }
+    }
+};
+
+// Skriver pladserne [first, last) fra en version af lageret som ét JSON-array
+// med chunked transfer encoding, eller i kolonneformatet som en
+// stream-header efterfulgt af én records-ramme pr. bid. Næste bid
+// serialiseres først, når den forrige er skrevet til socket'en, så
+// hukommelsen pr. forespørgsel er begrænset til én bid uanset hvor mange
+// poster der sendes.
+class weather_stream_t : public enable_shared_from_this<weather_stream_t>
+{
+public:
+    using response_t = restinio::response_builder_t<restinio::chunked_output_t>;
+    using slot_t = weather_store_t::slot_t;
+
+    static constexpr size_t records_per_chunk = 512;
+
+    weather_stream_t(
+        response_t resp,
+        shared_weather_store_t::snapshot_t snapshot,
+        slot_t first,
+        slot_t last,
+        bool columns = false)
+        : m_resp{move(resp)}
+        , m_snapshot{move(snapshot)}
+        , m_first{first}
+        , m_next{first}
+        , m_last{last}
+        , m_columns{columns}
+    {}
+
+    void write_next()
+    {
+        if (m_columns) {
+            write_columns_next();
+            return;
+        }
+
+        string chunk;
+        chunk.reserve(2 + records_per_chunk * (weather_json_record_size + 1));
+        if (m_next == m_first) {
+            chunk += '[';
+        }
+        const slot_t chunk_end = min(m_last, m_next + records_per_chunk);
+        for (; m_next < chunk_end; ++m_next) {
+            if (m_next != m_first) {
+                chunk += ',';
+            }
+            append_weather_json(chunk, m_snapshot->record(m_next));
+        }
+
+        if (m_next == m_last) {
+            chunk += ']';
+            m_resp.append_chunk(move(chunk));
+            m_resp.done();
+            return;
+        }
+
+        flush_and_continue(move(chunk));
+    }
+
+private:
+    response_t m_resp;
+    const shared_weather_store_t::snapshot_t m_snapshot; // Holder versionen i live
+    const slot_t m_first;
+    slot_t m_next;
+    const slot_t m_last;
+    const bool m_columns;
+
+    void write_columns_next()
+    {
+        string chunk;
+        if (m_next == m_first) {
+            chunk = weather_columns_stream_header(m_last - m_first);
+        }
+        if (m_next < m_last) {
+            const slot_t chunk_end = min(m_last, m_next + records_per_chunk);
+            chunk += weather_to_columns(*m_snapshot, m_next, chunk_end);
+            chunk.append((8 - chunk.size() % 8) % 8, '\0'); // Næste ramme på en 8-byte-grænse
+            m_next = chunk_end;
+        }
 
-    place_t() = default;
+        if (m_next == m_last) {
+            m_resp.append_chunk(move(chunk));
+            m_resp.done();
+            return;
+        }
+        flush_and_continue(move(chunk));
+    }
 
-    place_t(string name, double lat, double lon)
-        : m_name{move(name)}, m_lat{lat}, m_lon{lon}
+    void flush_and_continue(string chunk)
+    {
+        m_resp.append_chunk(move(chunk));
+        m_resp.flush([self = shared_from_this()](const auto& ec) {
+            if (!ec) {
+                self->write_next();
+            }
+        });
+    }
+};
+
+namespace rws = restinio::websocket::basic;
+
+class weather_handler_t;
+using router_t = static_router_t<weather_handler_t>;
+
+// shared_ostream_logger_t er trådsikker, så de samme traits kan bruges både
+// på hovedtråden og i en trådpulje
+using traits_t =
+    restinio::traits_t<
+        restinio::asio_timer_manager_t,
+        restinio::shared_ostream_logger_t,
+        router_t>;
+
+// En live_subscriber_t's forbindelse som WebSocket
+class ws_live_socket_t : public live_socket_t
+{
+public:
+    explicit ws_live_socket_t(rws::ws_handle_t ws)
+        : m_ws(move(ws))
     {}
 
+    void send(shared_ptr<const string> message, bool binary, written_t written) override
+    {
+        m_ws->send_message(
+            rws::final_frame, binary ? rws::opcode_t::binary_frame : rws::opcode_t::text_frame,
+            restinio::writable_item_t{move(message)},
+            [written = move(written)](const auto& ec) { written(!ec); });
+    }
+
+    void kill() override { m_ws->kill(); }
+
+private:
+    const rws::ws_handle_t m_ws;
+};
+
+// Kun typen af en besked fra en abonnent på /weather/live
+struct ws_message_type_t
+{
+    string m_type;
+
     template <typename JSON_IO>
     void json_io(JSON_IO &io)
     {
-        io & json_dto::mandatory("Navn", m_name)
-           & json_dto::mandatory("Lat", m_lat)
-           & json_dto::mandatory("Lon", m_lon);
+        io & json_dto::mandatory("type", m_type);
     }
 };
 
-// Definition af strukturen for Dato og Tid (DateTime)
-struct dateTime_t
+// Besked fra en (gen)forbundet abonnent, der vil have ændringerne siden
+// løbenummer since i den kørsel, epoch angiver:
+//   {"type": "resync", "since": 1234, "epoch": "18c2f..."}
+// Dækker ændringsloggen dem, er svaret én weather_delta med dem (kun den
+// seneste udgave af hver post) og "resync": true. Klienten anvender den,
+// selv om den har set et højere seq i mellemtiden: efter "lagged" kan der
+// komme rammer, der er nyere end de smidte, inden svaret. Ellers, eller
+// uden since, er svaret
+//   {"type": "resync_required", "seq": 1300, "epoch": "18c2f..."}
+// og klienten henter GET /weather og anvender derefter kun rammer med et
+// højere seq end det angivne.
+struct ws_resync_message_t
 {
-    string m_date; // Dato
-    string m_time; // Klokkeslæt
+    string m_type;
+    optional<uint64_t> m_since;
+    optional<string> m_epoch;
 
-    dateTime_t() = default;
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        io & json_dto::mandatory("type", m_type)
+           & json_dto::optional_no_default("since", m_since)
+           & json_dto::optional_no_default("epoch", m_epoch);
+    }
+};
 
-    dateTime_t(string date, string time)
-        : m_date{move(date)}, m_time{move(time)}
+// Opsætning fra kommandolinjen, fx "--threads=32"
+struct server_config_t
+{
+    // 1 = kør på hovedtråden, 0 = én tråd pr. kerne
+    size_t m_threads = 1;
+    // Antal seneste poster der holdes færdigserialiseret til /weather/latest/:n
+    size_t m_latest_capacity = 100;
+    // Fil til write-ahead-loggen; tom = ingen persistens
+    string m_wal_path;
+    // Længste tid en ændring venter på at blive skrevet til disken
+    size_t m_wal_commit_ms = 5;
+    // Snapshot-fil der indlæses ved start og skrives ved stop; tom = ingen
+    string m_snapshot_path;
+    // Sekunder mellem snapshots i baggrunden; 0 = kun ved stop
+    size_t m_snapshot_interval_s = 60;
+    // Højst så mange ventende beskeder pr. /weather/live-forbindelse
+    size_t m_ws_queue_limit = 64;
+    ws_overflow_policy_t m_ws_overflow_policy = ws_overflow_policy_t::coalesce;
+    // Ændringer samles i én delta-ramme pr. så mange ms; 0 = send straks
+    size_t m_ws_flush_ms = 100;
+    // Antal ændringer der huskes til resync af /weather/live-forbindelser
+    size_t m_ws_log_capacity = 10000;
+};
+
+// Ringbuffer med de seneste N oprettede poster som færdigserialiseret JSON.
+// Kapaciteten er fast; en ny post overskriver den ældste.
+class latest_ring_t
+{
+public:
+    explicit latest_ring_t(size_t capacity)
+        : m_entries(capacity)
     {}
 
-    template <typename JSON_IO>
-    void json_io(JSON_IO &io)
+    size_t capacity() const { return m_entries.size(); }
+    size_t size() const { return m_size; }
+
+    void push(uint64_t id, shared_ptr<const string> json)
     {
-        io & json_dto::mandatory("Dato", m_date)
-           & json_dto::mandatory("Klokkeslæt", m_time);
+        if (m_entries.empty()) {
+            return;
+        }
+        m_entries[m_head] = {id, move(json)};
+        m_head = (m_head + 1) % m_entries.size();
+        m_size = min(m_size + 1, m_entries.size());
     }
 
-    bool operator<(const dateTime_t& other) const {
-        if (m_date != other.m_date) {
-            return m_date < other.m_date; // Sammenlign dato først
+    // Erstatter JSON for posten, hvis den stadig er i bufferen (ved PUT)
+    void replace(uint64_t id, shared_ptr<const string> json)
+    {
+        for (size_t i = 0; i < m_size; ++i) {
+            auto& entry = at(i);
+            if (entry.m_id == id) {
+                entry.m_json = move(json);
+                return;
+            }
         }
-        return m_time < other.m_time; // Hvis ens sammenlign klokkeslæt
     }
-    bool operator==(const dateTime_t& other) const {
-        return m_date == other.m_date && m_time == other.m_time;
+
+    // JSON-array med de seneste n poster (n <= size()), ældste først
+    string latest_json(size_t n) const
+    {
+        string result = "[";
+        for (size_t i = m_size - n; i < m_size; ++i) {
+            if (i != m_size - n) {
+                result += ',';
+            }
+            result += *at(i).m_json;
+        }
+        result += ']';
+        return result;
+    }
+
+private:
+    struct entry_t
+    {
+        uint64_t m_id = 0;
+        shared_ptr<const string> m_json;
+    };
+
+    vector<entry_t> m_entries;
+    size_t m_head = 0; // Næste plads der skrives i
+    size_t m_size = 0;
+
+    // Den i'te ældste post
+    entry_t& at(size_t i)
+    {
+        return m_entries[(m_head + m_entries.size() - m_size + i) % m_entries.size()];
+    }
+    const entry_t& at(size_t i) const
+    {
+        return m_entries[(m_head + m_entries.size() - m_size + i) % m_entries.size()];
     }
 };
 
-// Definition af strukturen for Vejrudsigt (Weathercast data)
-struct weathercast_t
+// Status for én post i en batch (POST /weather/batch)
+struct batch_result_t
 {
-    string m_id;
-    dateTime_t m_dateTime;   // Dato og tid
-    place_t m_place;         // Sted
-    double m_temperature;    // Temperatur
-    int m_humidity;          // Luftfugtighed
-
-    weathercast_t() = default;
-
-    weathercast_t(
-        string id,
-        dateTime_t dateTime,
-        place_t place,
-        double temperature,
-        int humidity)
-        : m_id{move(id)},
-          m_dateTime{move(dateTime)},
-          m_place{move(place)},
-          m_temperature{temperature},
-          m_humidity{humidity}
-    {}
+    size_t m_index = 0;       // Postens plads i batchen
+    int m_status = 0;         // HTTP-status for posten alene
+    optional<string> m_id;    // Tildelt ID, hvis posten blev oprettet
+    optional<string> m_error; // Fejlbesked, hvis den ikke blev
 
     template <typename JSON_IO>
     void json_io(JSON_IO &io)
     {
-        io & json_dto::optional("ID", m_id, "")
-           & json_dto::mandatory("Tidspunkt (dato og klokkeslæt)", m_dateTime)
-           & json_dto::mandatory("Sted", m_place)
-           & json_dto::mandatory("Temperatur", m_temperature)
-           & json_dto::mandatory("Luftfugtighed", m_humidity);
+        io & json_dto::mandatory("index", m_index)
+           & json_dto::mandatory("status", m_status)
+           & json_dto::optional_no_default("ID", m_id)
+           & json_dto::optional_no_default("error", m_error);
     }
 };
 
-namespace rr = restinio::router;
-namespace rws = restinio::websocket::basic;
-using router_t = rr::express_router_t<>;
-
-using ws_registry_t = std::map<std::uint64_t, rws::ws_handle_t>; // Definer WebSocket registry
-
-
-class weather_handler_t
+class weather_handler_t : public enable_shared_from_this<weather_handler_t>
 {
 public:
-    explicit weather_handler_t(vector<weathercast_t> &weather_data)
+    weather_handler_t(
+        shared_weather_store_t &weather_data,
+        const server_config_t &config,
+        write_ahead_log_t *wal,
+        const persistence_metrics_t &persistence_metrics)
         : m_weather_data(weather_data)
-        , m_next_id(1) // Initialiser ID
-    {
-        // Sikre unikt ID
-        if (!m_weather_data.empty()) {
-            int max_id = 0;
-            for (const auto& wc : m_weather_data) {
-                try {
-                    int current_id = stoi(wc.m_id);
-                    if (current_id > max_id) {
-                        max_id = current_id;
-                    }
-                } catch (const exception& e) {
-                    
-				}
-            }
-            m_next_id = max_id + 1;
+        , m_wal(wal)
+        , m_persistence_metrics(persistence_metrics)
+        , m_ws_queue_limit(config.m_ws_queue_limit)
+        , m_ws_overflow_policy(config.m_ws_overflow_policy)
+        , m_change_log_capacity(config.m_ws_log_capacity)
+        , m_etag_prefix(make_etag_prefix())
+    {
+        if (config.m_ws_flush_ms > 0) {
+            m_live_batcher = make_unique<live_batcher_t>(
+                chrono::milliseconds{config.m_ws_flush_ms},
+                [this](vector<live_change_t> changes) {
+                    lock_guard lock{m_change_log_lock};
+                    send_delta(changes);
+                });
+        }
+
+        // Fyld ringbufferen med de seneste poster fra start
+        auto latest = make_shared<latest_ring_t>(config.m_latest_capacity);
+        const auto snapshot = m_weather_data.snapshot();
+        const size_t first = snapshot->size() - min(snapshot->size(), latest->capacity());
+        for (size_t slot = first; slot < snapshot->size(); ++slot) {
+            latest->push(snapshot->id_at(slot),
+                make_shared<const string>(weather_to_json(snapshot->record(slot))));
         }
+        m_latest = move(latest);
     }
 
     weather_handler_t(const weather_handler_t &) = delete;
     weather_handler_t(weather_handler_t &&) = delete;
 
-    // Til et unikt ID
-    string generate_unique_id() {
-        return to_string(m_next_id++);
-    }
-
     // GET ALL
     auto on_get_all_weather(
-        const restinio::request_handle_t& req, rr::route_params_t) const
+        const restinio::request_handle_t& req, const static_route_params_t&) const
     {
-        auto resp = init_json_resp(req->create_response());
-        resp.set_body(json_dto::to_json(m_weather_data));
+        if (!req->header().query().empty()) {
+            return on_get_weather_page(req);
+        }
+        return respond_all_weather(req);
+    }
+
+    // Hele datasættet fra den serialiserede cache, med ETag
+    restinio::request_handling_status_t respond_all_weather(
+        const restinio::request_handle_t& req) const
+    {
+        const bool columns = wants_columns(req);
+        const auto cached = all_weather_body(columns);
+
+        // Klienten har allerede den aktuelle version: 304 uden body
+        const auto if_none_match =
+            req->header().get_field_or(restinio::http_field::if_none_match, "");
+        if (etag_matches(if_none_match, cached->m_etag)) {
+            return init_weather_resp(req->create_response(restinio::status_not_modified()), columns)
+                .append_header(restinio::http_field::etag, cached->m_etag)
+                .append_header(restinio::http_field::cache_control, "no-cache")
+                .append_header("Access-Control-Expose-Headers", "ETag")
+                .done();
+        }
+
+        auto resp = init_weather_resp(req->create_response(), columns);
+        resp.append_header(restinio::http_field::etag, cached->m_etag)
+            .append_header(restinio::http_field::cache_control, "no-cache")
+            .append_header("Access-Control-Expose-Headers", "ETag")
+            .set_body(cached->m_body); // Deles mellem svarene, kopieres ikke
+        return resp.done();
+    }
+
+    // GET ALL med ?limit=N&after=ID (side efter posten med ID) og/eller
+    // ?stream=1 (hele resultatet streamet i bidder)
+    restinio::request_handling_status_t on_get_weather_page(
+        const restinio::request_handle_t& req) const
+    {
+        optional<uint64_t> limit;
+        optional<uint64_t> after;
+        bool stream = false;
+        const char* error = nullptr;
+        try {
+            const auto qp = restinio::parse_query(req->header().query());
+            if (qp.has("limit")) {
+                limit = weather_store_t::parse_id(qp["limit"]);
+                if (!limit || *limit == 0 || *limit > max_page_size) {
+                    error = R"({"error": "limit skal være mellem 1 og 10000"})";
+                }
+            }
+            if (qp.has("after")) {
+                after = weather_store_t::parse_id(qp["after"]);
+                if (!after) {
+                    error = R"({"error": "after skal være et ID"})";
+                }
+            }
+            stream = qp.has("stream") && qp["stream"] != "0" && qp["stream"] != "false";
+        } catch (const exception&) {
+            error = R"({"error": "Ugyldig forespørgsel"})";
+        }
+
+        if (error) {
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(error)
+                       .done();
+        }
+        if (!stream && !limit && !after) {
+            return respond_all_weather(req); // Ingen kendte parametre
+        }
+        if (!stream && !limit) {
+            limit = default_page_size;
+        }
+
+        const auto snapshot = m_weather_data.snapshot();
+
+        // Cursoren slås op i ID-indekset, så siden starter uden at scanne
+        size_t first = 0;
+        if (after) {
+            const auto slot = snapshot->slot_of(*after);
+            if (!slot) {
+                return req->create_response(restinio::status_not_found())
+                           .set_body(R"({"error": "Vejrdata med angivet ID (after) blev ikke fundet"})")
+                           .done();
+            }
+            first = *slot + 1;
+        }
+        const size_t last = limit
+            ? static_cast<size_t>(min<uint64_t>(snapshot->size(), first + *limit))
+            : snapshot->size();
+
+        // Link til næste side, hvis der er flere poster
+        string next_cursor;
+        if (last < snapshot->size() && last > first) {
+            next_cursor = to_string(snapshot->id_at(last - 1));
+        }
+
+        const bool columns = wants_columns(req);
+        if (stream) {
+            auto resp = init_weather_resp(req->create_response<restinio::chunked_output_t>(), columns);
+            append_page_headers(resp, next_cursor, last - first);
+            make_shared<weather_stream_t>(move(resp), snapshot, first, last, columns)->write_next();
+            return restinio::request_accepted();
+        }
+
+        auto resp = init_weather_resp(req->create_response(), columns);
+        append_page_headers(resp, next_cursor, last - first);
+        resp.set_body(columns ? weather_to_columns(*snapshot, first, last) : weather_to_json(*snapshot, first, last));
         return resp.done();
     }
 
     // GET ID
     auto on_get_weather_by_id(
-        const restinio::request_handle_t& req, rr::route_params_t params) const
+        const restinio::request_handle_t& req, const static_route_params_t& params) const
     {
         auto resp = init_json_resp(req->create_response());
-        const auto id = params["id"]; 
+        const auto id = weather_store_t::parse_id(params["id"]);
+        const auto found = id ? m_weather_data.snapshot()->find_by_id(*id) : nullopt;
 
-        auto it = find_if(m_weather_data.begin(), m_weather_data.end(),
-                               [&](const weathercast_t& wc){ return wc.m_id == id; });
-
-        if (it != m_weather_data.end()) {
-            resp.set_body(json_dto::to_json(*it)); 
+        if (found) {
+            resp.set_body(weather_to_json(*found)); 
         } else {
             // Hvis ID ikke findes, fejlkode 404
             return req->create_response(restinio::status_not_found())
@@ -166,77 +608,134 @@ public:
 
     // GET DATE
     auto on_get_weather_by_date(
-        const restinio::request_handle_t& req, rr::route_params_t params) const
+        const restinio::request_handle_t& req, const static_route_params_t& params) const
     {
-        auto resp = init_json_resp(req->create_response());
-        const auto date_str = params["date"]; 
-
-        vector<weathercast_t> result;
-        for (const auto& wc : m_weather_data) {
-            string stored_date_normalized = wc.m_dateTime.m_date;
-            stored_date_normalized.erase(
-                remove(stored_date_normalized.begin(), stored_date_normalized.end(), '.'),
-                stored_date_normalized.end());
-
-            if (stored_date_normalized == date_str) {
-                result.push_back(wc); 
-            }
-        }
-        resp.set_body(json_dto::to_json(result));
+        const bool columns = wants_columns(req);
+        auto resp = init_weather_resp(req->create_response(), columns);
+        const auto day = dateTime_t::try_parse_date(params["date"]);
+
+        // En ugyldig dato har ingen data
+        const auto records = day ? m_weather_data.snapshot()->find_by_date_range(*day, *day)
+                                 : vector<weathercast_t>{};
+        resp.set_body(columns ? weather_to_columns(records) : weather_to_json(records));
         return resp.done();
     }
 
-    // GET LATEST_THREE
-    auto on_get_latest_three(
-        const restinio::request_handle_t& req, rr::route_params_t ) const
+    // GET RANGE
+    auto on_get_weather_by_range(
+        const restinio::request_handle_t& req, const static_route_params_t& params) const
     {
-        auto resp = init_json_resp(req->create_response());
+        const auto from = dateTime_t::try_parse_date(params["from"]);
+        const auto to = dateTime_t::try_parse_date(params["to"]);
 
-        if (m_weather_data.empty()) {
-            resp.set_body("[]");
-            return resp.done();
+        if (!from || !to) {
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(R"({"error": "Ugyldig dato i intervallet"})")
+                       .done();
         }
-        vector<weathercast_t> latest_three_uploaded;
-        
-        size_t start_index = 0;
-        if (m_weather_data.size() > 3) {
-            start_index = m_weather_data.size() - 3;
+        if (*from > *to) {
+            // Fejlkode 400 hvis intervallet er vendt om
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(R"({"error": "Startdatoen skal ligge før eller på slutdatoen"})")
+                       .done();
         }
 
-        for (size_t i = start_index; i < m_weather_data.size(); ++i) {
-            latest_three_uploaded.push_back(m_weather_data[i]);
+        auto resp = init_json_resp(req->create_response());
+        resp.set_body(weather_to_json(m_weather_data.snapshot()->find_by_date_range(*from, *to)));
+        return resp.done();
+    }
+
+    // GET PLACE
+    auto on_get_weather_by_place(
+        const restinio::request_handle_t& req, const static_route_params_t& params) const
+    {
+        string name;
+        try {
+            name = restinio::utils::unescape_percent_encoding(params["name"]);
+        } catch (const exception&) {
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(R"({"error": "Ugyldigt stednavn"})")
+                       .done();
         }
 
-        resp.set_body(json_dto::to_json(latest_three_uploaded));
+        auto resp = init_json_resp(req->create_response());
+        resp.set_body(weather_to_json(m_weather_data.snapshot()->find_by_place(name)));
         return resp.done();
     }
 
+    // GET LATEST_THREE
+    auto on_get_latest_three(
+        const restinio::request_handle_t& req, const static_route_params_t&) const
+    {
+        return respond_latest(req, 3);
+    }
+
+    // GET LATEST N
+    auto on_get_latest(
+        const restinio::request_handle_t& req, const static_route_params_t& params) const
+    {
+        const auto n = weather_store_t::parse_id(params["n"]);
+        if (!n) {
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(R"({"error": "Ugyldigt antal"})")
+                       .done();
+        }
+        return respond_latest(req, *n);
+    }
+
     // POST
     auto on_post_weather(
-        const restinio::request_handle_t& req, rr::route_params_t )
+        const restinio::request_handle_t& req, const static_route_params_t&)
     {
+        if (log_failed()) {
+            return respond_log_failed(req);
+        }
         try {
-            weathercast_t new_weather = json_dto::from_json<weathercast_t>(req->body());
-
-            auto it = find_if(m_weather_data.begin(), m_weather_data.end(),
-                [&](const weathercast_t& wc) {
-                    return wc.m_dateTime == new_weather.m_dateTime;
-                });
-
-            if (it != m_weather_data.end()) {
+            weathercast_t new_weather = weather_from_json(req->body());
+            new_weather.m_id.clear(); // ID tildeles af lageret
+
+            // Ringbufferen, loggen og løbenummeret til /weather/live tildeles
+            // under skrivelåsen, så de følger lagerets rækkefølge
+            write_ahead_log_t::lsn_t lsn = 0;
+            uint64_t ticket = 0;
+            string id;
+            const auto json = write_store([&](weather_store_t& store) {
+                shared_ptr<const string> inserted;
+                if (!store.contains_time(new_weather.m_dateTime)) {
+                    const auto record = store.insert(move(new_weather));
+                    const uint64_t numeric_id = store.id_at(store.size() - 1);
+                    id = record.m_id;
+                    if (m_wal) {
+                        lsn = m_wal->log_insert(record);
+                    }
+                    inserted = make_shared<const string>(weather_to_json(record));
+                    update_latest([&](latest_ring_t& latest) {
+                        latest.push(numeric_id, inserted);
+                    });
+                    ticket = m_live_sequencer.stage({{true, numeric_id, record, inserted}});
+                }
+                return inserted;
+            });
+
+            if (!json) {
                 return req->create_response(restinio::status_conflict()) // 409 Conflict
                            .set_body(R"({"error": "En vejrudsigt med dette tidspunkt eksisterer allerede."})")
                            .done();
             }
 
-            new_weather.m_id = generate_unique_id(); 
-
-            m_weather_data.push_back(new_weather); 
-            sendMessage(json_dto::to_json(new_weather)); // opdaterer WebSocket
-
-            auto resp = init_json_resp(req->create_response(restinio::status_created()));
-            resp.set_body(json_dto::to_json(new_weather)); 
-            return resp.done();
+            // Svaret sendes først, når posten er skrevet til disken
+            when_durable(lsn, [self = shared_from_this(), req, id, ticket, json](bool durable) {
+                self->m_live_sequencer.release(ticket); // opdaterer WebSocket
+                if (!durable) {
+                    respond_not_durable(req, R"("ID": ")" + id + "\"");
+                    return;
+                }
+
+                auto resp = init_json_resp(req->create_response(restinio::status_created()));
+                resp.set_body(json); 
+                resp.done();
+            });
+            return restinio::request_accepted();
         } catch (const exception& ex) {
             return req->create_response(restinio::status_bad_request())
                        .set_body(string("Fejl ved parsning af JSON: ") + ex.what())
@@ -244,29 +743,133 @@ public:
         }
     }
 
+    // POST BATCH
+    // Kroppen er et JSON-array eller NDJSON (én vejrudsigt pr. linje). Alle
+    // poster indsættes under én skrivning og giver én samlet WebSocket-besked.
+    auto on_post_weather_batch(
+        const restinio::request_handle_t& req, const static_route_params_t&)
+    {
+        if (log_failed()) {
+            return respond_log_failed(req);
+        }
+        vector<optional<weathercast_t>> records;
+        vector<batch_result_t> results;
+        if (!parse_batch(req->body(), records, results)) {
+            return req->create_response(restinio::status_bad_request())
+                       .set_body(R"({"error": "Batchen skal være et JSON-array eller NDJSON"})")
+                       .done();
+        }
+
+        write_ahead_log_t::lsn_t lsn = 0;
+        uint64_t ticket = 0;
+        write_store([&](weather_store_t& store) {
+            vector<live_change_t> created;
+
+            // Dubletter afvises både mod lageret og inden for batchen
+            vector<weathercast_t> accepted;
+            vector<size_t> positions; // Plads i records for hver accepteret post
+            unordered_set<int64_t> times;
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (!records[i]) {
+                    continue; // Kunne ikke parses
+                }
+                if (store.contains_time(records[i]->m_dateTime) ||
+                    !times.insert(records[i]->m_dateTime.m_minutes).second) {
+                    results[i].m_status = 409;
+                    results[i].m_error = "En vejrudsigt med dette tidspunkt eksisterer allerede.";
+                    continue;
+                }
+                records[i]->m_id.clear(); // ID tildeles af lageret
+                accepted.push_back(move(*records[i]));
+                positions.push_back(i);
+            }
+
+            // Indeksene opdateres én gang for hele batchen
+            const auto inserted = store.insert_batch(move(accepted));
+            const size_t first_slot = store.size() - inserted.size();
+            for (size_t k = 0; k < inserted.size(); ++k) {
+                const auto& record = inserted[k];
+                if (m_wal) {
+                    lsn = m_wal->log_insert(record);
+                }
+                created.push_back({true, store.id_at(first_slot + k), record,
+                    make_shared<const string>(weather_to_json(record))});
+                results[positions[k]].m_status = 201;
+                results[positions[k]].m_id = record.m_id;
+            }
+
+            if (!created.empty()) {
+                update_latest([&](latest_ring_t& latest) {
+                    for (const auto& change : created) {
+                        latest.push(change.m_id, change.m_json);
+                    }
+                });
+            }
+            // Løbenumrene følger lageret ligesom ved POST og PUT
+            ticket = m_live_sequencer.stage(move(created));
+        });
+
+        // Hele batchen venter på én fælles skrivning til disken
+        when_durable(lsn, [self = shared_from_this(), req, ticket, results = move(results)](bool durable) {
+            // Én ramme for hele batchen, hvis samling er slået fra
+            self->m_live_sequencer.release(ticket);
+            if (!durable) {
+                respond_not_durable(req, R"("results": )" + json_dto::to_json(results));
+                return;
+            }
+
+            auto resp = init_json_resp(req->create_response());
+            resp.set_body(json_dto::to_json(results));
+            resp.done();
+        });
+        return restinio::request_accepted();
+    }
+
     // PUT ID
     auto on_put_weather(
-        const restinio::request_handle_t& req, rr::route_params_t params)
+        const restinio::request_handle_t& req, const static_route_params_t& params)
     {
-        const auto id_to_update = params["id"]; 
+        if (log_failed()) {
+            return respond_log_failed(req);
+        }
+        const auto id_to_update = weather_store_t::parse_id(params["id"]);
 
         try {
-            weathercast_t updated_data = json_dto::from_json<weathercast_t>(req->body());
-
-            auto it = find_if(m_weather_data.begin(), m_weather_data.end(),
-                                   [&](const weathercast_t& wc){ return wc.m_id == id_to_update; });
-
-            if (it != m_weather_data.end()) {
-                it->m_dateTime = updated_data.m_dateTime;
-                it->m_place = updated_data.m_place;
-                it->m_temperature = updated_data.m_temperature;
-                it->m_humidity = updated_data.m_humidity;
+            weathercast_t updated_data = weather_from_json(req->body());
+
+            shared_ptr<const string> json;
+            write_ahead_log_t::lsn_t lsn = 0;
+            uint64_t ticket = 0;
+            if (id_to_update) {
+                json = write_store([&](weather_store_t& store) {
+                    shared_ptr<const string> updated;
+                    if (const auto record = store.update(*id_to_update, updated_data)) {
+                        if (m_wal) {
+                            lsn = m_wal->log_update(*record);
+                        }
+                        updated = make_shared<const string>(weather_to_json(*record));
+                        update_latest([&](latest_ring_t& latest) {
+                            latest.replace(*id_to_update, updated);
+                        });
+                        ticket = m_live_sequencer.stage({{false, *id_to_update, *record, updated}});
+                    }
+                    return updated;
+                });
+            }
 
-                sendMessage(json_dto::to_json(*it)); // opdaterer WebSocket
+            if (json) {
+                when_durable(lsn, [self = shared_from_this(), req, id = *id_to_update, ticket, json](bool durable) {
+                    self->m_live_sequencer.release(ticket); // opdaterer WebSocket
+                    if (!durable) {
+                        respond_not_durable(req, R"("ID": ")" + to_string(id) + "\"");
+                        return;
+                    }
 
-                auto resp = init_json_resp(req->create_response(restinio::status_ok()));
-                resp.set_body(json_dto::to_json(*it)); 
-                return resp.done();
+                    auto resp = init_json_resp(req->create_response(restinio::status_ok()));
+                    resp.set_body(json); 
+                    resp.done();
+                });
+                return restinio::request_accepted();
             } else {
                 // Fejlkode 404 hvis ID ikke findes
                 return req->create_response(restinio::status_not_found())
@@ -280,35 +883,69 @@ public:
         }
     }
 
+    // GET /metrics i Prometheus' tekstformat
+    auto on_get_metrics(
+        const restinio::request_handle_t& req, const static_route_params_t&) const
+    {
+        const auto& metrics = m_persistence_metrics;
+        const auto snapshot = m_weather_data.snapshot();
+        string body;
+        auto metric = [&](const char* name, const char* type, uint64_t value) {
+            body += string("# TYPE ") + name + " " + type + "\n" + name + " " + to_string(value) + "\n";
+        };
+        metric("weather_records", "gauge", snapshot->size());
+        metric("weather_store_version", "counter", snapshot->version());
+        metric("weather_wal_last_lsn", "counter", m_wal ? m_wal->last_lsn() : 0);
+        metric("weather_wal_failed", "gauge", log_failed() ? 1 : 0);
+        metric("weather_snapshots_total", "counter", metrics.m_snapshots);
+        metric("weather_snapshot_failures_total", "counter", metrics.m_failures);
+        metric("weather_snapshot_last_records", "gauge", metrics.m_last_records);
+        metric("weather_snapshot_last_duration_microseconds", "gauge", metrics.m_last_duration_us);
+        metric("weather_snapshot_max_duration_microseconds", "gauge", metrics.m_max_duration_us);
+        metric("weather_snapshot_last_pause_microseconds", "gauge", metrics.m_last_pause_us);
+        metric("weather_snapshot_max_pause_microseconds", "gauge", metrics.m_max_pause_us);
+        {
+            shared_lock lock{m_registry_lock};
+            metric("weather_ws_subscribers", "gauge", m_registry.size());
+            metric("weather_ws_filtered_subscribers", "gauge", m_registry.filtered());
+        }
+        metric("weather_ws_messages_sent_total", "counter", m_ws_metrics->m_sent);
+        metric("weather_ws_messages_dropped_total", "counter", m_ws_metrics->m_dropped);
+        metric("weather_ws_messages_coalesced_total", "counter", m_ws_metrics->m_coalesced);
+        metric("weather_ws_disconnected_total", "counter", m_ws_metrics->m_disconnected);
+        metric("weather_ws_delta_frames_total", "counter", m_live_batcher ? m_live_batcher->frames() : 0);
+        metric("weather_ws_delta_changes_total", "counter", m_live_batcher ? m_live_batcher->changes() : 0);
+        metric("weather_ws_seq", "counter", m_live_seq);
+        metric("weather_ws_resyncs_total", "counter", m_ws_metrics->m_resyncs);
+        metric("weather_ws_resyncs_required_total", "counter", m_ws_metrics->m_resyncs_required);
+
+        return req->create_response(restinio::status_ok())
+            .append_header(restinio::http_field::content_type, "text/plain; version=0.0.4; charset=utf-8")
+            .set_body(move(body))
+            .done();
+    }
+
     // Root
     auto on_root_get(
-        const restinio::request_handle_t& req, rr::route_params_t ) const
+        const restinio::request_handle_t& req, const static_route_params_t&) const
     {
         auto resp = init_json_resp(req->create_response(restinio::status_ok()));
-        resp.set_body(R"({"message": "Velkommen til Vejr API'et! Tilgå /weather for alle data, /weather/:id for specifikt ID, /weather/date/:date for data på dato, /latest_three for de seneste tre. Brug POST på /weather og PUT på /weather/:id."})");
+        resp.set_body(R"({"message": "Velkommen til Vejr API'et! Tilgå /weather for alle data (?limit=&after= for sider, ?stream=1 for streaming), /weather/:id for specifikt ID, /weather/date/:date for data på dato, /weather/range/:from/:to for data i et datointerval, /weather/place/:name for data for et sted, /latest_three for de seneste tre, /weather/latest/:n for de seneste n, /metrics for driftstal. Send Accept: application/x-weather-columns på /weather, /weather/date/:date og /weather/live for et kompakt binært kolonneformat. Brug POST på /weather (eller /weather/batch for mange på én gang) og PUT på /weather/:id."})");
         return resp.done();
     }
 
-    auto on_live_update(const restinio::request_handle_t &req, rr::route_params_t)
+    auto on_live_update(const restinio::request_handle_t &req, const static_route_params_t&)
     {
         if (restinio::http_connection_header_t::upgrade ==
             req->header().connection())
         {
-            auto wsh = rws::upgrade<
-                restinio::traits_t<
-                    restinio::asio_timer_manager_t,
-                    restinio::single_threaded_ostream_logger_t,
-                    router_t
-                >
-            >(
+            auto wsh = rws::upgrade<traits_t>(
                 *req, rws::activation_t::immediate,
                 [this](auto wsh_in, auto m)
                 {
-                    if (rws::opcode_t::text_frame == m->opcode() ||
-                        rws::opcode_t::binary_frame == m->opcode() ||
-                        rws::opcode_t::continuation_frame == m->opcode())
+                    if (rws::opcode_t::text_frame == m->opcode())
                     {
-                        wsh_in->send_message(*m);
+                        on_client_message(wsh_in->connection_id(), m->payload());
                     }
                     else if (rws::opcode_t::ping_frame == m->opcode())
                     {
@@ -318,10 +955,16 @@ public:
                     }
                     else if (rws::opcode_t::connection_close_frame == m->opcode())
                     {
-                        m_registry.erase(wsh_in->connection_id());
+                        update_registry([&](ws_registry_t& registry) {
+                            registry.erase(wsh_in->connection_id());
+                        });
                     }
                 });
-            m_registry.emplace(wsh->connection_id(), wsh);
+            auto subscriber = make_shared<live_subscriber_t>(
+                make_shared<ws_live_socket_t>(wsh), m_ws_queue_limit, m_ws_overflow_policy, m_ws_metrics, wants_columns(req));
+            update_registry([&](ws_registry_t& registry) {
+                registry.add(wsh->connection_id(), move(subscriber));
+            });
             init_json_resp(req->create_response()).done();
             return restinio::request_accepted();
         }
@@ -329,9 +972,64 @@ public:
     }
 
 private:
-    vector<weathercast_t> &m_weather_data; 
-    int m_next_id; 
+    static constexpr uint64_t default_page_size = 1000;
+    static constexpr uint64_t max_page_size = 10000;
+
+    // Færdigt serialiseret svar på GET /weather for én version af lageret
+    struct cached_body_t
+    {
+        uint64_t m_version;
+        string m_etag;
+        shared_ptr<const string> m_body;
+    };
+
+    shared_weather_store_t &m_weather_data; 
+    write_ahead_log_t *m_wal; // nullptr hvis serveren kører uden log
+    const persistence_metrics_t &m_persistence_metrics;
+    const size_t m_ws_queue_limit;
+    const ws_overflow_policy_t m_ws_overflow_policy;
+    const shared_ptr<ws_metrics_t> m_ws_metrics = make_shared<ws_metrics_t>();
+
+    // De seneste frigivne ændringer i løbenummerorden, til resync. Låsen
+    // holdes også mens rammerne lægges i køerne, så et resync-svar aldrig
+    // overhales af en nyere ramme.
+    const size_t m_change_log_capacity;
+    deque<live_change_t> m_change_log;
+    atomic<uint64_t> m_live_seq{0}; // Senest frigivne løbenummer
+    mutex m_change_log_lock;
+
+    // Giver ændringer løbenumre under lagerets skrivelås og frigiver dem,
+    // når de er på disken, så /weather/live ser dem i lagerets rækkefølge
+    live_sequencer_t m_live_sequencer{[this](vector<live_change_t> changes) {
+        publish_changes(move(changes));
+    }};
+
+    // Bygges én gang pr. version og deles af alle samtidige svar. Læses og
+    // skrives med atomic_load/atomic_store; m_cache_lock sikrer at kun én
+    // tråd serialiserer en ny version ad gangen.
+    mutable shared_ptr<const cached_body_t> m_all_weather_cache;
+    mutable shared_ptr<const cached_body_t> m_all_weather_columns_cache;
+    mutable mutex m_cache_lock;
+
+    // Skelner ETags fra forskellige kørsler, da versionen starter forfra
+    const string m_etag_prefix;
+
+    // De seneste poster. Ændres kun under lagerets skrivelås og udgives
+    // som en ny kopi med atomic_store, så læsere aldrig ser en halv ændring,
+    // og først efter lagerets nye version, så en post aldrig findes her
+    // uden at findes i lageret.
+    shared_ptr<const latest_ring_t> m_latest;
+    shared_ptr<latest_ring_t> m_latest_next; // Ændret kopi, til write_store udgiver den
+
+    // Forbindelser til /weather/live. Ændres på stedet under eneret til
+    // låsen; udsendelser slår op under delt lås og sender først bagefter,
+    // så en forbindelse, der lukkes under afsendelsen, kan afmelde sig.
     ws_registry_t m_registry;
+    mutable shared_mutex m_registry_lock;
+
+    // Samler ændringer til delta-rammer; nullptr hvis de sendes straks.
+    // Sidst, så tråden stoppes før resten af handleren nedlægges.
+    unique_ptr<live_batcher_t> m_live_batcher;
 
     template <typename RESP>
     static RESP
@@ -344,174 +1042,642 @@ private:
         return resp;
     }
 
-    void sendMessage(std::string message)
+    // Som init_json_resp, men for svar der kan være i kolonneformatet
+    // (weather_columns.hpp); Vary fortæller caches, at svaret afhænger af Accept
+    template <typename RESP>
+    static RESP
+    init_weather_resp(RESP resp, bool columns)
+    {
+        resp.append_header("Server", "RESTinio Weather API /v.0.2")
+            .append_header_date_field()
+            .append_header("Content-Type", columns ? weather_columns_media_type : "application/json; charset=utf-8")
+            .append_header("Access-Control-Allow-Origin", "*")
+            .append_header(restinio::http_field::vary, "Accept");
+        return resp;
+    }
+
+    // Om klienten beder om kolonneformatet frem for JSON
+    static bool wants_columns(const restinio::request_handle_t& req)
+    {
+        return prefers_columns(req->header().get_field_or(restinio::http_field::accept, ""));
+    }
+
+    // Efter en fejl i loggen kan intet gøres holdbart, så ændringer afvises
+    bool log_failed() const
     {
-        for (auto const& [id, ws_handle] : m_registry) {
-            ws_handle->send_message(rws::final_frame, rws::opcode_t::text_frame, message);
+        return m_wal && m_wal->failed();
+    }
+
+    static restinio::request_handling_status_t respond_log_failed(const restinio::request_handle_t& req)
+    {
+        return req->create_response(restinio::status_service_unavailable())
+                   .set_body(R"({"error": "Loggen kan ikke skrives; ændringer modtages ikke"})")
+                   .done();
+    }
+
+    // Ændringen er allerede i lageret og kan ses af alle, men loggen fejlede,
+    // før den nåede disken. details er resten af JSON-objektet (fx ID'et).
+    static void respond_not_durable(const restinio::request_handle_t& req, const string& details)
+    {
+        req->create_response(restinio::status_internal_server_error())
+            .set_body(R"({"error": "Vejrdata er gemt, men kunne ikke skrives til disken og går tabt ved genstart", )" +
+                      details + "}")
+            .done();
+    }
+
+    // Kalder respond, når ændringen med løbenummer lsn er på disken, eller
+    // med det samme hvis serveren kører uden log (eller intet blev logget)
+    template <typename F>
+    void when_durable(write_ahead_log_t::lsn_t lsn, F&& respond)
+    {
+        if (m_wal && lsn != 0) {
+            m_wal->when_durable(lsn, forward<F>(respond));
+        } else {
+            respond(true);
         }
     }
-};
 
-auto server_handler(vector<weathercast_t> &weather_data_ref)
-{
-    auto router = std::make_unique<router_t>();
-    auto handler = std::make_shared<weather_handler_t>(std::ref(weather_data_ref));
+    // Skriver i lageret som shared_weather_store_t::write og udgiver
+    // bagefter ringbufferen, hvis writer ændrede den med update_latest
+    template <typename F>
+    invoke_result_t<F, weather_store_t&> write_store(F&& writer)
+    {
+        return m_weather_data.write(
+            [&](weather_store_t& store) {
+                m_latest_next.reset(); // Rester fra en skrivning, der kastede
+                return writer(store);
+            },
+            [&] {
+                if (m_latest_next) {
+                    atomic_store(&m_latest, shared_ptr<const latest_ring_t>{move(m_latest_next)});
+                }
+            });
+    }
 
-    auto by = [&](auto method) {
-        using namespace placeholders;
-        return bind(method, handler, _1, _2);
-    };
-    // CORS for /weather
-    router->add_handler(
-        restinio::http_method_options(),
-        "/weather",
-        [](const restinio::request_handle_t& req, rr::route_params_t ) {
-            return req->create_response(restinio::status_ok())
-                .append_header("Access-Control-Allow-Origin", "*")
-                .append_header("Access-Control-Allow-Methods", "GET, POST, OPTIONS") 
-                .append_header("Access-Control-Allow-Headers", "Content-Type")
-                .append_header("Access-Control-Max-Age", "86400") 
-                .done();
-        });
-    // CORS for /weather/:id
-    router->add_handler(
-        restinio::http_method_options(),
-        R"(/weather/:id([0-9]+))",
-        [](const restinio::request_handle_t& req, rr::route_params_t ) {
-            return req->create_response(restinio::status_ok())
-                .append_header("Access-Control-Allow-Origin", "*")
-                .append_header("Access-Control-Allow-Methods", "GET, PUT, OPTIONS")
-                .append_header("Access-Control-Allow-Headers", "Content-Type")
-                .append_header("Access-Control-Max-Age", "86400")
-                .done();
-        });
-    // CORS for /weather/live (WebSocket)
-    router->add_handler(
-        restinio::http_method_options(),
-        "/weather/live",
-        [](const restinio::request_handle_t& req, rr::route_params_t ) {
-            return req->create_response(restinio::status_ok())
-                .append_header("Access-Control-Allow-Origin", "*")
-                .append_header("Access-Control-Allow-Methods", "GET, OPTIONS") // WebSocket upgrade uses GET
-                .append_header("Access-Control-Allow-Headers", "Content-Type, Upgrade, Connection")
-                .append_header("Access-Control-Max-Age", "86400")
-                .done();
+    // Ændrer en kopi af ringbufferen, som write_store udgiver efter lageret.
+    // Må kun kaldes inde fra write_store.
+    template <typename F>
+    void update_latest(F&& change)
+    {
+        if (!m_latest_next) {
+            m_latest_next = make_shared<latest_ring_t>(*m_latest);
+        }
+        change(*m_latest_next);
+    }
+
+    // De seneste n poster, ældste først. Fra ringbufferen hvis den rækker,
+    // ellers fra enden af lageret.
+    restinio::request_handling_status_t respond_latest(
+        const restinio::request_handle_t& req, uint64_t n) const
+    {
+        auto resp = init_json_resp(req->create_response());
+
+        const auto latest = atomic_load(&m_latest);
+        if (n <= latest->capacity()) {
+            resp.set_body(latest->latest_json(min<size_t>(n, latest->size())));
+            return resp.done();
+        }
+
+        const auto snapshot = m_weather_data.snapshot();
+        const size_t count = static_cast<size_t>(min<uint64_t>(n, snapshot->size()));
+        resp.set_body(weather_to_json(*snapshot, snapshot->size() - count, snapshot->size()));
+        return resp.done();
+    }
+
+    template <typename RESP>
+    static void append_page_headers(RESP& resp, const string& next_cursor, size_t page_size)
+    {
+        if (next_cursor.empty()) {
+            return;
+        }
+        resp.append_header("X-Next-Cursor", next_cursor)
+            .append_header(restinio::http_field::link,
+                "</weather?limit=" + to_string(page_size) + "&after=" + next_cursor + ">; rel=\"next\"")
+            .append_header("Access-Control-Expose-Headers", "X-Next-Cursor, Link");
+    }
+
+    static string make_etag_prefix()
+    {
+        const auto started = chrono::system_clock::now().time_since_epoch().count();
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%llx", static_cast<unsigned long long>(started));
+        return buf;
+    }
+
+    // Svaret på GET /weather for den aktuelle version, fra cachen hvis muligt.
+    // Hvert format har sin egen cache og sit eget ETag.
+    shared_ptr<const cached_body_t> all_weather_body(bool columns) const
+    {
+        auto& cache = columns ? m_all_weather_columns_cache : m_all_weather_cache;
+        const auto snapshot = m_weather_data.snapshot();
+        auto cached = atomic_load(&cache);
+        if (cached && cached->m_version == snapshot->version()) {
+            return cached;
+        }
+
+        lock_guard lock{m_cache_lock};
+        cached = atomic_load(&cache);
+        if (cached && cached->m_version >= snapshot->version()) {
+            return cached; // En anden tråd nåede det (evt. en nyere version)
+        }
+
+        cached = make_shared<const cached_body_t>(cached_body_t{
+            snapshot->version(),
+            "\"" + m_etag_prefix + "-" + to_string(snapshot->version()) + (columns ? "-columns" : "") + "\"",
+            make_shared<const string>(columns ? weather_to_columns(*snapshot, 0, snapshot->size())
+                                              : weather_to_json(*snapshot, 0, snapshot->size()))});
+        atomic_store(&cache, cached);
+        return cached;
+    }
+
+    // Matcher If-None-Match ("*" eller en kommasepareret liste, evt. W/"...")
+    static bool etag_matches(string_view if_none_match, string_view etag)
+    {
+        while (!if_none_match.empty()) {
+            const auto comma = if_none_match.find(',');
+            string_view candidate = if_none_match.substr(0, comma);
+            if_none_match = comma == string_view::npos
+                ? string_view{} : if_none_match.substr(comma + 1);
+
+            while (!candidate.empty() && candidate.front() == ' ') candidate.remove_prefix(1);
+            while (!candidate.empty() && candidate.back() == ' ') candidate.remove_suffix(1);
+            if (candidate.substr(0, 2) == "W/") candidate.remove_prefix(2);
+
+            if (candidate == "*" || candidate == etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Deler en batch op i poster. records[i] er tom, hvis post i ikke kunne
+    // parses; results[i] har da allerede status 400. Giver false, hvis
+    // kroppen hverken er et JSON-array eller NDJSON.
+    static bool parse_batch(
+        string_view body,
+        vector<optional<weathercast_t>>& records,
+        vector<batch_result_t>& results)
+    {
+        auto add = [&](auto&& parse) {
+            batch_result_t result;
+            result.m_index = results.size();
+            try {
+                records.emplace_back(parse());
+            } catch (const exception& ex) {
+                records.emplace_back(nullopt);
+                result.m_status = 400;
+                result.m_error = string("Fejl ved parsning af JSON: ") + ex.what();
+            }
+            results.push_back(move(result));
+        };
+
+        const auto first = body.find_first_not_of(" \t\r\n");
+        if (first == string_view::npos) {
+            return true; // Tom batch
+        }
+
+        if (body[first] == '[') {
+            rapidjson::Document document;
+            document.Parse(body.data(), body.size());
+            if (document.HasParseError() || !document.IsArray()) {
+                return false;
+            }
+            for (const auto& item : document.GetArray()) {
+                add([&] { return json_dto::from_json<weathercast_t>(item); });
+            }
+            return true;
+        }
+
+        while (!body.empty()) {
+            const auto end = body.find('\n');
+            string_view line = body.substr(0, end);
+            body = end == string_view::npos ? string_view{} : body.substr(end + 1);
+            if (line.find_first_not_of(" \t\r") == string_view::npos) {
+                continue; // Tomme linjer springes over
+            }
+            add([&] { return weather_from_json(line); });
+        }
+        return true;
+    }
+
+    // Afleverer frigivne ændringer fra m_live_sequencer i løbenummerorden:
+    // husker dem i ændringsloggen og sender dem samlet i næste delta-ramme,
+    // eller straks hvis samling er slået fra
+    void publish_changes(vector<live_change_t> changes)
+    {
+        {
+            lock_guard lock{m_change_log_lock};
+            m_change_log.insert(m_change_log.end(), changes.begin(), changes.end());
+            while (m_change_log.size() > m_change_log_capacity) {
+                m_change_log.pop_front();
+            }
+            m_live_seq = changes.back().m_seq;
+            if (!m_live_batcher) {
+                send_delta(changes);
+                return;
+            }
+        }
+        for (auto& change : changes) {
+            m_live_batcher->add(move(change));
+        }
+    }
+
+    // Sender changes som delta-rammer til de forbindelser, der abonnerer
+    // på dem. Hver ramme har det højeste løbenummer, den dækker.
+    // m_change_log_lock skal holdes.
+    void send_delta(const vector<live_change_t>& changes)
+    {
+        sendMessage(changes, live_delta_frame);
+    }
+
+    // Sender changes til de forbindelser, der abonnerer på dem, med
+    // frame_for som i send_routes, og fjerner dem, der er lukket. Hver
+    // forbindelse har sin egen begrænsede kø (se live_subscriber_t).
+    template <typename F>
+    void sendMessage(const vector<live_change_t>& changes, F&& frame_for)
+    {
+        vector<ws_registry_t::route_t> routes;
+        {
+            shared_lock lock{m_registry_lock};
+            routes = m_registry.route(changes);
+        }
+        const auto closed = send_routes(routes, changes, frame_for);
+        if (!closed.empty()) {
+            update_registry([&](ws_registry_t& current) {
+                for (const uint64_t id : closed) {
+                    current.erase(id);
+                }
+            });
+        }
+    }
+
+    // Tekstbesked fra en forbindelse til /weather/live
+    void on_client_message(uint64_t connection_id, const string& payload)
+    {
+        shared_ptr<const string> reply;
+        try {
+            const auto type = json_dto::from_json<ws_message_type_t>(payload).m_type;
+            if (type == "subscribe") {
+                reply = on_subscribe(connection_id, json_dto::from_json<ws_subscribe_message_t>(payload));
+            } else if (type == "resync") {
+                on_resync(connection_id, json_dto::from_json<ws_resync_message_t>(payload));
+                return; // Svaret er sendt under ændringsloggens lås
+            } else {
+                throw invalid_argument("Ukendt type");
+            }
+        } catch (const exception&) {
+            reply = make_shared<const string>(
+                R"({"type": "error", "error": "Beskeden skal have type \"subscribe\" (med places og/eller bbox) eller \"resync\""})");
+        }
+        // Svaret går gennem samme kø som opdateringerne
+        if (const auto subscriber = find_subscriber(connection_id)) {
+            subscriber->send(move(reply));
+        }
+    }
+
+    // Skifter forbindelsens abonnement (se ws_subscribe_message_t)
+    shared_ptr<const string> on_subscribe(uint64_t connection_id, ws_subscribe_message_t subscription)
+    {
+        const auto& bbox = subscription.m_bbox;
+        if (bbox && (bbox->m_min_lat > bbox->m_max_lat || bbox->m_min_lon > bbox->m_max_lon)) {
+            throw invalid_argument("Ugyldigt område");
+        }
+        subscription.m_type = "subscribed";
+        auto reply = make_shared<const string>(json_dto::to_json(subscription));
+        update_registry([&](ws_registry_t& registry) {
+            registry.subscribe(connection_id, move(subscription));
         });
+        return reply;
+    }
 
-    router->http_get("/weather", by(&weather_handler_t::on_get_all_weather));
-    router->http_get("/", by(&weather_handler_t::on_root_get));
+    // Sender de ændringer, forbindelsen har misset, eller beder den hente
+    // alt forfra (se ws_resync_message_t)
+    void on_resync(uint64_t connection_id, const ws_resync_message_t& request)
+    {
+        ws_registry_t::entry_t entry;
+        {
+            shared_lock lock{m_registry_lock};
+            const auto found = m_registry.find(connection_id);
+            if (!found) {
+                return;
+            }
+            entry = *found;
+        }
+
+        lock_guard lock{m_change_log_lock};
+        const uint64_t seq = m_live_seq;
+        const uint64_t first = m_change_log.empty() ? seq + 1 : m_change_log.front().m_seq;
+        const bool covered = request.m_since && request.m_epoch == m_etag_prefix &&
+                             *request.m_since <= seq && *request.m_since + 1 >= first;
+        if (!covered) {
+            ++m_ws_metrics->m_resyncs_required;
+            entry.m_subscriber->send(make_shared<const string>(
+                R"({"type": "resync_required", "seq": )" + to_string(seq) +
+                R"(, "epoch": ")" + m_etag_prefix + R"("})"));
+            return;
+        }
+
+        // Kun den seneste udgave af hver post, som i live_batcher_t
+        vector<live_change_t> missed;
+        unordered_map<uint64_t, size_t> position;
+        for (auto it = m_change_log.begin() + (*request.m_since + 1 - first); it != m_change_log.end(); ++it) {
+            if (!entry.m_subscription.matches(it->m_record.m_place)) {
+                continue;
+            }
+            const auto [found, inserted] = position.emplace(it->m_id, missed.size());
+            if (inserted) {
+                missed.push_back(*it);
+            } else {
+                auto& latest = missed[found->second];
+                latest.m_record = it->m_record;
+                latest.m_json = it->m_json;
+            }
+        }
+        vector<size_t> indices(missed.size());
+        iota(indices.begin(), indices.end(), 0);
+        ++m_ws_metrics->m_resyncs;
+        if (entry.m_subscriber->columns()) {
+            entry.m_subscriber->send(columns_delta_frame(missed, indices, seq, true), true);
+        } else {
+            entry.m_subscriber->send(delta_frame(missed, indices, seq, true));
+        }
+    }
+
+    // Ændrer registret med eneret til det
+    template <typename F>
+    void update_registry(F&& change)
+    {
+        unique_lock lock{m_registry_lock};
+        change(m_registry);
+    }
+
+    // Abonnenten for forbindelsen, eller nullptr hvis den ikke er tilmeldt
+    shared_ptr<live_subscriber_t> find_subscriber(uint64_t connection_id)
+    {
+        shared_lock lock{m_registry_lock};
+        const auto entry = m_registry.find(connection_id);
+        return entry ? entry->m_subscriber : nullptr;
+    }
+};
+
+// Svar på OPTIONS (CORS) for en rute
+template <const char* METHODS, const char* HEADERS>
+restinio::request_handling_status_t on_cors_options(
+    weather_handler_t&, const restinio::request_handle_t& req, const static_route_params_t&)
+{
+    return req->create_response(restinio::status_ok())
+        .append_header("Access-Control-Allow-Origin", "*")
+        .append_header("Access-Control-Allow-Methods", METHODS)
+        .append_header("Access-Control-Allow-Headers", HEADERS)
+        .append_header("Access-Control-Max-Age", "86400")
+        .done();
+}
+
+constexpr char cors_weather_methods[] = "GET, POST, OPTIONS";
+constexpr char cors_weather_headers[] = "Content-Type, If-None-Match";
+constexpr char cors_batch_methods[] = "POST, OPTIONS";
+constexpr char cors_id_methods[] = "GET, PUT, OPTIONS";
+constexpr char cors_live_methods[] = "GET, OPTIONS"; // WebSocket upgrade uses GET
+constexpr char cors_live_headers[] = "Content-Type, Upgrade, Connection";
+constexpr char cors_content_type[] = "Content-Type";
+
+template <auto METHOD>
+constexpr auto call = call_route<weather_handler_t, METHOD>;
+
+// Alle ruter. Mønstrene deles i segmenter ved oversættelsen (se static_router.hpp)
+constexpr array<static_route_t<weather_handler_t>, 17> weather_routes{{
+    // CORS for /weather, /weather/batch, /weather/:id og /weather/live (WebSocket)
+    {route_method_t::options, "/weather", on_cors_options<cors_weather_methods, cors_weather_headers>},
+    {route_method_t::options, "/weather/batch", on_cors_options<cors_batch_methods, cors_content_type>},
+    {route_method_t::options, "/weather/:id(number)", on_cors_options<cors_id_methods, cors_content_type>},
+    {route_method_t::options, "/weather/live", on_cors_options<cors_live_methods, cors_live_headers>},
+
+    {route_method_t::get, "/weather", call<&weather_handler_t::on_get_all_weather>},
+    {route_method_t::get, "/", call<&weather_handler_t::on_root_get>},
+    {route_method_t::get, "/metrics", call<&weather_handler_t::on_get_metrics>},
 
     // LAB 2 ruter, for de nye krav
-    router->http_get(
-        R"(/weather/:id([0-9]+))",
-        by(&weather_handler_t::on_get_weather_by_id)
-    );
+    {route_method_t::get, "/weather/:id(number)", call<&weather_handler_t::on_get_weather_by_id>},
     // GET /weather/date/:date
-    router->http_get(
-        R"(/weather/date/:date([0-9]{8}))",
-        by(&weather_handler_t::on_get_weather_by_date)
-    );
-    // GET /weather/latest_three 
-    router->http_get("/weather/latest_three", by(&weather_handler_t::on_get_latest_three));
+    {route_method_t::get, "/weather/date/:date(date)", call<&weather_handler_t::on_get_weather_by_date>},
+    // GET /weather/range/:from/:to
+    {route_method_t::get, "/weather/range/:from(date)/:to(date)", call<&weather_handler_t::on_get_weather_by_range>},
+    // GET /weather/place/:name
+    {route_method_t::get, "/weather/place/:name", call<&weather_handler_t::on_get_weather_by_place>},
+    // GET /weather/latest_three
+    {route_method_t::get, "/weather/latest_three", call<&weather_handler_t::on_get_latest_three>},
+    // GET /weather/latest/:n
+    {route_method_t::get, "/weather/latest/:n(number)", call<&weather_handler_t::on_get_latest>},
 
     // POST /weather
-    router->http_post("/weather", by(&weather_handler_t::on_post_weather));
+    {route_method_t::post, "/weather", call<&weather_handler_t::on_post_weather>},
+    // POST /weather/batch
+    {route_method_t::post, "/weather/batch", call<&weather_handler_t::on_post_weather_batch>},
 
     // PUT /weather/:id
-    router->http_put(
-        R"(/weather/:id([0-9]+))",
-        by(&weather_handler_t::on_put_weather)
-    );
-
-    router->http_get("/weather/live", by(&weather_handler_t::on_live_update));  // WebSocket upgrade
-
-    // Catch all for det der ikke håndteres, returnerer 405 Method Not Allowed med CORS-headere
-    router->add_handler(
-        restinio::router::none_of_methods(),
-        ".*", // Match any route
-        [](const restinio::request_handle_t& req, auto) {
+    {route_method_t::put, "/weather/:id(number)", call<&weather_handler_t::on_put_weather>},
+
+    {route_method_t::get, "/weather/live", call<&weather_handler_t::on_live_update>}, // WebSocket upgrade
+}};
+
+auto server_handler(
+    shared_weather_store_t &weather_data_ref,
+    const server_config_t &config,
+    write_ahead_log_t *wal,
+    const persistence_metrics_t &persistence_metrics)
+{
+    auto handler = std::make_shared<weather_handler_t>(
+        std::ref(weather_data_ref), config, wal, std::cref(persistence_metrics));
+
+    return std::make_unique<router_t>(
+        move(handler),
+        weather_routes,
+        // Catch all for det der ikke håndteres, returnerer 404 Not Found med CORS-headere
+        [](const restinio::request_handle_t& req) {
+            return req->create_response(restinio::status_not_found())
+                .append_header("Content-Type", "application/json; charset=utf-8")
+                .append_header("Access-Control-Allow-Origin", "*")
+                .set_body(R"({"error": "Route not found"})")
+                .done();
+        },
+        // En kendt rute med en anden metode, returnerer 405 Method Not Allowed med CORS-headere
+        [](const restinio::request_handle_t& req) {
             return req->create_response(restinio::status_method_not_allowed())
                 .append_header("Content-Type", "application/json; charset=utf-8")
                 .append_header("Access-Control-Allow-Origin", "*")
                 .set_body(R"({"error": "Method not allowed"})")
                 .done();
-        }
-    );
+        });
+}
 
-    // Catch all for det der ikke håndteres, returnerer 404 Not Found med CORS-headere
-    router->non_matched_request_handler([](const restinio::request_handle_t& req) {
-        return req->create_response(restinio::status_not_found())
-            .append_header("Content-Type", "application/json; charset=utf-8")
-            .append_header("Access-Control-Allow-Origin", "*")
-            .set_body(R"({"error": "Route not found"})")
-            .done();
-    });
+// Værdien efter "--navn=" eller tomt resultat hvis argumentet ikke er "--navn"
+optional<string_view> option_value(string_view arg, string_view name)
+{
+    if (arg.size() > name.size() && arg.substr(0, name.size()) == name &&
+        arg[name.size()] == '=') {
+        return arg.substr(name.size() + 1);
+    }
+    return nullopt;
+}
 
-    return router;
+server_config_t parse_config(int argc, char* argv[])
+{
+    server_config_t config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg{argv[i]};
+        if (const auto value = option_value(arg, "--threads")) {
+            config.m_threads = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--latest")) {
+            config.m_latest_capacity = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--wal")) {
+            config.m_wal_path = string(*value);
+        } else if (const auto value = option_value(arg, "--wal-commit-ms")) {
+            config.m_wal_commit_ms = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--snapshot")) {
+            config.m_snapshot_path = string(*value);
+        } else if (const auto value = option_value(arg, "--snapshot-interval")) {
+            config.m_snapshot_interval_s = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--ws-flush-ms")) {
+            config.m_ws_flush_ms = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--ws-log")) {
+            config.m_ws_log_capacity = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--ws-queue")) {
+            config.m_ws_queue_limit = stoul(string(*value));
+        } else if (const auto value = option_value(arg, "--ws-policy")) {
+            if (*value == "drop-oldest") {
+                config.m_ws_overflow_policy = ws_overflow_policy_t::drop_oldest;
+            } else if (*value == "coalesce") {
+                config.m_ws_overflow_policy = ws_overflow_policy_t::coalesce;
+            } else if (*value == "disconnect") {
+                config.m_ws_overflow_policy = ws_overflow_policy_t::disconnect;
+            } else {
+                throw invalid_argument("Ukendt --ws-policy: " + string(*value));
+            }
+        } else {
+            throw invalid_argument("Ukendt parameter: " + string(arg));
+        }
+    }
+    if (config.m_threads == 0) {
+        config.m_threads = max(1u, thread::hardware_concurrency());
+    }
+    return config;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
     using namespace chrono;
 
     try
     {
-        vector<weathercast_t> weather_data_storage;
+        const server_config_t config = parse_config(argc, argv);
+        weather_store_t weather_data_storage;
+
+        // Et snapshot mappes ind uden parsning; loggen afspilles oven på det
+        uint64_t log_position = 0;
+        if (!config.m_snapshot_path.empty() && ::access(config.m_snapshot_path.c_str(), F_OK) == 0) {
+            const auto started = steady_clock::now();
+            weather_data_storage = weather_store_t::load_snapshot(config.m_snapshot_path, log_position);
+            cout << "Indlæste " << weather_data_storage.size() << " poster fra " << config.m_snapshot_path
+                 << " på " << duration_cast<milliseconds>(steady_clock::now() - started).count() << " ms" << endl;
+        }
 
-        place_t aarhus_n_place{"Aarhus N", 56.17, 10.22};
-        place_t copenhagen_place{"Risskov", 55.67, 12.56};
+        // Med --wal afspilles loggen derefter; startdata bruges kun første gang
+        unique_ptr<write_ahead_log_t> wal;
+        if (!config.m_wal_path.empty()) {
+            wal = make_unique<write_ahead_log_t>(
+                config.m_wal_path, milliseconds{config.m_wal_commit_ms}, weather_data_storage, log_position);
+            cout << "Afspillede " << wal->replayed() << " poster fra " << config.m_wal_path << endl;
+        }
 
-        weather_data_storage.push_back({
-            "1",
-            dateTime_t{"2024.04.15", "10:15"},
-            aarhus_n_place,
-            13.1,
-            70
-        });
-        weather_data_storage.push_back({
-            "2",
-            dateTime_t{"2024.04.15", "11:30"},
-            copenhagen_place,
-            15.5,
-            65
-        });
-        weather_data_storage.push_back({
-            "3", 
-            dateTime_t{"2024.04.16", "09:00"},
-            aarhus_n_place,
-            10.0,
-            80
-        });
-        weather_data_storage.push_back({
-            "4", 
-            dateTime_t{"2024.04.16", "14:00"},
-            copenhagen_place,
-            12.8,
-            75
-        });
-        weather_data_storage.push_back({
-            "5",
-            dateTime_t{"2024.04.17", "08:30"},
-            aarhus_n_place,
-            9.5,
-            85
-        });
+        if (weather_data_storage.empty()) {
+            place_t aarhus_n_place{"Aarhus N", 56.17, 10.22};
+            place_t copenhagen_place{"Risskov", 55.67, 12.56};
+
+            weather_data_storage.insert({
+                "1",
+                dateTime_t{"2024.04.15", "10:15"},
+                aarhus_n_place,
+                13.1,
+                70
+            });
+            weather_data_storage.insert({
+                "2",
+                dateTime_t{"2024.04.15", "11:30"},
+                copenhagen_place,
+                15.5,
+                65
+            });
+            weather_data_storage.insert({
+                "3", 
+                dateTime_t{"2024.04.16", "09:00"},
+                aarhus_n_place,
+                10.0,
+                80
+            });
+            weather_data_storage.insert({
+                "4", 
+                dateTime_t{"2024.04.16", "14:00"},
+                copenhagen_place,
+                12.8,
+                75
+            });
+            weather_data_storage.insert({
+                "5",
+                dateTime_t{"2024.04.17", "08:30"},
+                aarhus_n_place,
+                9.5,
+                85
+            });
+
+            if (wal) {
+                for (size_t slot = 0; slot < weather_data_storage.size(); ++slot) {
+                    wal->log_insert(weather_data_storage.record(slot));
+                }
+                wal->sync();
+            }
+        }
 
-        using traits_t =
-            restinio::traits_t<
-                restinio::asio_timer_manager_t,
-                restinio::single_threaded_ostream_logger_t,
-                router_t>;
+        shared_weather_store_t shared_storage{move(weather_data_storage)};
 
-        cout << "Starter server på localhost:8080..." << endl;
-        restinio::run(
-            restinio::on_this_thread<traits_t>()
+        // Gemmer snapshots i baggrunden uden at røre event-loopet
+        persistence_metrics_t persistence_metrics;
+        unique_ptr<snapshot_writer_t> snapshot_writer;
+        if (!config.m_snapshot_path.empty() && config.m_snapshot_interval_s > 0) {
+            snapshot_writer = make_unique<snapshot_writer_t>(
+                shared_storage, wal.get(), config.m_snapshot_path,
+                seconds{config.m_snapshot_interval_s}, persistence_metrics);
+        }
+
+        auto with_server_settings = [&](auto settings) {
+            return move(settings)
                 .address("localhost")
                 .port(8080)
-                .request_handler(server_handler(weather_data_storage))
+                .request_handler(server_handler(shared_storage, config, wal.get(), persistence_metrics))
                 .read_next_http_message_timelimit(10s)
                 .write_http_response_timelimit(1s)
-                .handle_request_timeout(1s));
+                .handle_request_timeout(1s);
+        };
+
+        cout << "Starter server på localhost:8080 med " << config.m_threads
+             << (config.m_threads == 1 ? " tråd..." : " tråde...") << endl;
+        if (config.m_threads == 1) {
+            restinio::run(with_server_settings(restinio::on_this_thread<traits_t>()));
+        } else {
+            restinio::run(with_server_settings(restinio::on_thread_pool<traits_t>(config.m_threads)));
+        }
+
+        // Serveren er stoppet: gem et snapshot, som loggen så ikke behøver gentage
+        snapshot_writer.reset();
+        if (!config.m_snapshot_path.empty()) {
+            if (wal) {
+                wal->sync();
+            }
+            shared_storage.snapshot()->save_snapshot(config.m_snapshot_path, wal ? wal->last_lsn() : 0);
+            if (wal) {
+                wal->clear();
+            }
+            cout << "Gemte snapshot i " << config.m_snapshot_path << endl;
+        }
     }
     catch (const exception &ex)
     {
@@ -0,0 +1,261 @@
+// Router med en fast rutetabel, der opdeles i segmenter ved oversættelsen.
+// Et mønster som "/weather/range/:from(date)/:to(date)" består af faste
+// segmenter og parametre; en parameter kan have typen
+//   number  1-20 cifre (ID'er og antal)
+//   date    præcis 8 cifre (ÅÅÅÅMMDD)
+//   text    alt andet end tom (standard, fx ":name")
+// Et ugyldigt mønster giver en fejl ved oversættelsen. Ved en forespørgsel
+// deles stien én gang i segmenter, som sammenlignes med tabellen uden
+// regulære udtryk og uden at allokere.
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <restinio/all.hpp>
+
+// De metoder, ruterne skelner mellem
+enum class route_method_t { get, post, put, options, other };
+
+inline route_method_t route_method(const restinio::http_method_id_t& method)
+{
+    if (method == restinio::http_method_get()) {
+        return route_method_t::get;
+    }
+    if (method == restinio::http_method_post()) {
+        return route_method_t::post;
+    }
+    if (method == restinio::http_method_put()) {
+        return route_method_t::put;
+    }
+    if (method == restinio::http_method_options()) {
+        return route_method_t::options;
+    }
+    return route_method_t::other;
+}
+
+constexpr size_t max_route_segments = 4;
+
+enum class route_segment_kind_t { literal, number, date, text };
+
+struct route_segment_t
+{
+    route_segment_kind_t m_kind = route_segment_kind_t::literal;
+    std::string_view m_text; // Den faste tekst eller parameterens navn
+
+    // Om et segment af en sti passer (kun for parametre)
+    constexpr bool accepts(std::string_view segment) const
+    {
+        switch (m_kind) {
+        case route_segment_kind_t::literal:
+            return segment == m_text;
+        case route_segment_kind_t::number:
+            return !segment.empty() && segment.size() <= 20 && all_digits(segment);
+        case route_segment_kind_t::date:
+            return segment.size() == 8 && all_digits(segment);
+        case route_segment_kind_t::text:
+            return !segment.empty();
+        }
+        return false;
+    }
+
+    static constexpr bool all_digits(std::string_view segment)
+    {
+        for (const char c : segment) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Et mønster delt i segmenter; "/" har ingen segmenter
+struct route_pattern_t
+{
+    std::array<route_segment_t, max_route_segments> m_segments{};
+    size_t m_size = 0;
+
+    template <size_t N>
+    constexpr route_pattern_t(const char (&pattern)[N])
+        : route_pattern_t(std::string_view{pattern, N - 1})
+    {}
+
+    constexpr explicit route_pattern_t(std::string_view pattern)
+    {
+        if (pattern.empty() || pattern.front() != '/') {
+            throw std::invalid_argument("Et mønster skal starte med /");
+        }
+        pattern.remove_prefix(1);
+        while (!pattern.empty()) {
+            if (m_size == max_route_segments) {
+                throw std::invalid_argument("For mange segmenter i mønsteret");
+            }
+            const auto slash = pattern.find('/');
+            m_segments[m_size++] = parse_segment(pattern.substr(0, slash));
+            pattern = slash == std::string_view::npos ? std::string_view{} : pattern.substr(slash + 1);
+        }
+    }
+
+private:
+    static constexpr route_segment_t parse_segment(std::string_view segment)
+    {
+        if (segment.empty()) {
+            throw std::invalid_argument("Tomt segment i mønsteret");
+        }
+        if (segment.front() != ':') {
+            return {route_segment_kind_t::literal, segment};
+        }
+        segment.remove_prefix(1);
+        const auto open = segment.find('(');
+        if (open == std::string_view::npos) {
+            return {route_segment_kind_t::text, segment};
+        }
+        if (open == 0 || segment.back() != ')') {
+            throw std::invalid_argument("Parameteren skal skrives :navn eller :navn(type)");
+        }
+        const auto name = segment.substr(0, open);
+        const auto type = segment.substr(open + 1, segment.size() - open - 2);
+        if (type == "number") {
+            return {route_segment_kind_t::number, name};
+        }
+        if (type == "date") {
+            return {route_segment_kind_t::date, name};
+        }
+        if (type == "text") {
+            return {route_segment_kind_t::text, name};
+        }
+        throw std::invalid_argument("Ukendt parametertype");
+    }
+};
+
+// Parametrene fra en matchet sti. Værdierne peger ind i forespørgslens
+// sti og er ikke afkodet (brug unescape_percent_encoding til tekst).
+class static_route_params_t
+{
+public:
+    std::string_view operator[](std::string_view name) const
+    {
+        for (size_t i = 0; i < m_size; ++i) {
+            if (m_params[i].first == name) {
+                return m_params[i].second;
+            }
+        }
+        throw std::invalid_argument("Ukendt ruteparameter: " + std::string(name));
+    }
+
+    void add(std::string_view name, std::string_view value) { m_params[m_size++] = {name, value}; }
+    void clear() { m_size = 0; }
+
+private:
+    std::array<std::pair<std::string_view, std::string_view>, max_route_segments> m_params;
+    size_t m_size = 0;
+};
+
+template <typename HANDLER>
+struct static_route_t
+{
+    using function_t = restinio::request_handling_status_t (*)(
+        HANDLER&, const restinio::request_handle_t&, const static_route_params_t&);
+
+    route_method_t m_method;
+    route_pattern_t m_pattern;
+    function_t m_function;
+};
+
+// Kalder en medlemsfunktion på handleren; til brug i en rutetabel
+template <typename HANDLER, auto METHOD>
+restinio::request_handling_status_t call_route(
+    HANDLER& handler, const restinio::request_handle_t& req, const static_route_params_t& params)
+{
+    return (handler.*METHOD)(req, params);
+}
+
+// Request handler til traits_t. Ruterne prøves i tabellens rækkefølge; en
+// sti der passer med en anden metode giver method_not_allowed, en sti der
+// ikke passer nogen rute giver not_found.
+template <typename HANDLER>
+class static_router_t
+{
+public:
+    using fallback_t = restinio::request_handling_status_t (*)(const restinio::request_handle_t&);
+
+    template <size_t N>
+    static_router_t(
+        std::shared_ptr<HANDLER> handler,
+        const std::array<static_route_t<HANDLER>, N>& routes,
+        fallback_t not_found,
+        fallback_t method_not_allowed)
+        : m_handler(std::move(handler))
+        , m_routes(routes.data())
+        , m_route_count(N)
+        , m_not_found(not_found)
+        , m_method_not_allowed(method_not_allowed)
+    {}
+
+    restinio::request_handling_status_t operator()(restinio::request_handle_t req) const
+    {
+        // Stien deles i segmenter; én afsluttende / ignoreres, men et tomt
+        // segment (som i "//" eller "/weather//1") passer ingen rute
+        std::string_view path = req->header().path();
+        if (path.empty() || path.front() != '/') {
+            return m_not_found(req);
+        }
+        path.remove_prefix(1);
+
+        std::array<std::string_view, max_route_segments> segments;
+        size_t count = 0;
+        while (!path.empty()) {
+            const auto slash = path.find('/');
+            if (count == max_route_segments || slash == 0) {
+                return m_not_found(req);
+            }
+            segments[count++] = path.substr(0, slash);
+            path = slash == std::string_view::npos ? std::string_view{} : path.substr(slash + 1);
+        }
+
+        const auto method = route_method(req->header().method());
+        bool path_matched = false;
+        static_route_params_t params;
+        for (size_t r = 0; r < m_route_count; ++r) {
+            const auto& route = m_routes[r];
+            if (route.m_pattern.m_size != count || !matches(route.m_pattern, segments, params)) {
+                continue;
+            }
+            if (route.m_method == method) {
+                return route.m_function(*m_handler, req, params);
+            }
+            path_matched = true;
+        }
+        return path_matched ? m_method_not_allowed(req) : m_not_found(req);
+    }
+
+private:
+    const std::shared_ptr<HANDLER> m_handler;
+    const static_route_t<HANDLER>* const m_routes; // En statisk tabel
+    const size_t m_route_count;
+    const fallback_t m_not_found;
+    const fallback_t m_method_not_allowed;
+
+    static bool matches(
+        const route_pattern_t& pattern,
+        const std::array<std::string_view, max_route_segments>& segments,
+        static_route_params_t& params)
+    {
+        params.clear();
+        for (size_t i = 0; i < pattern.m_size; ++i) {
+            const auto& segment = pattern.m_segments[i];
+            if (!segment.accepts(segments[i])) {
+                return false;
+            }
+            if (segment.m_kind != route_segment_kind_t::literal) {
+                params.add(segment.m_text, segments[i]);
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,101 @@
+// Fælles for testene: CHECK melder en fejlet betingelse med fil og linje
+// og tæller den; main slutter med return test_result(). Desuden poster
+// og et lager at teste med, og sammenligning af poster og lagre.
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "weather_store.hpp"
+
+inline int& test_failures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": fejlede: " #condition "\n"; \
+            ++test_failures();                                                        \
+        }                                                                             \
+    } while (false)
+
+// 0 hvis alle CHECK holdt, ellers 1
+inline int test_result()
+{
+    if (test_failures() != 0) {
+        std::cerr << test_failures() << " fejl" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// En post uden ID, som klienten sender den
+inline weathercast_t make_record(int64_t minutes, const std::string& place, double temperature)
+{
+    return weathercast_t{"", dateTime_t{minutes}, place_t{place, 56.0, 10.0}, temperature, 70};
+}
+
+inline bool same_record(const weathercast_t& a, const weathercast_t& b)
+{
+    return a.m_id == b.m_id && a.m_dateTime.m_minutes == b.m_dateTime.m_minutes &&
+           a.m_place.m_name == b.m_place.m_name && a.m_place.m_lat == b.m_place.m_lat &&
+           a.m_place.m_lon == b.m_place.m_lon && a.m_temperature == b.m_temperature &&
+           a.m_humidity == b.m_humidity;
+}
+
+inline bool same_records(const std::vector<weathercast_t>& a, const std::vector<weathercast_t>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!same_record(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Samme poster på samme pladser
+inline bool same_store(const weather_store_t& a, const weather_store_t& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t slot = 0; slot < a.size(); ++slot) {
+        if (!same_record(a.record(slot), b.record(slot))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Et lager bygget med alle slags skrivninger: 500 enkeltvise og 2500 i én
+// batch med ID 1-3000, hver 13. (fra ID 1) flyttet til et nyt tidspunkt
+// og stedet "Flyttet", og en post med ID 3100 (et hul i ID-rækken) på et
+// sted med samme navn som et andet, men andre koordinater
+inline weather_store_t make_test_store()
+{
+    weather_store_t store;
+    for (int64_t i = 0; i < 500; ++i) {
+        store.insert(make_record(i * 60, "Sted " + std::to_string(i % 7), static_cast<double>(i)));
+    }
+    std::vector<weathercast_t> batch;
+    for (int64_t i = 500; i < 3000; ++i) {
+        batch.push_back(make_record(i * 60, "Sted " + std::to_string(i % 11), static_cast<double>(i) / 2));
+    }
+    store.insert_batch(std::move(batch));
+    for (uint64_t id = 1; id <= 3000; id += 13) {
+        store.update(id, make_record(100'000 + static_cast<int64_t>(id), "Flyttet", -1.5));
+    }
+    weathercast_t elsewhere = make_record(1, "Sted 3", 20);
+    elsewhere.m_place.m_lat = 55.0;
+    elsewhere.m_id = "3100";
+    store.insert(elsewhere);
+    return store;
+}
@@ -0,0 +1,202 @@
+// Tester at kopier af lageret er uafhængige (copy-on-write): en kopi deler
+// blade med originalen, men skrivninger i den ene ses aldrig i den anden,
+// heller ikke i indeksene, stedsordbogen eller versionen, og heller ikke
+// når kopien ændrer i et blad, den deler med en tredje.
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "weather_store.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+// Alt hvad man kan læse af et lager, taget som almindelige værdier, så det
+// kan sammenlignes, efter at lageret (eller en kopi af det) er ændret
+struct contents_t
+{
+    uint64_t m_version = 0;
+    std::vector<weathercast_t> m_records;
+    std::vector<weathercast_t> m_by_date;
+    std::vector<std::vector<weathercast_t>> m_by_place;
+
+    static const std::vector<std::string>& places()
+    {
+        static const std::vector<std::string> names{"Sted 0", "Sted 3", "Sted 10", "Flyttet", "Flyttet igen", "Ny"};
+        return names;
+    }
+
+    static contents_t of(const weather_store_t& store)
+    {
+        contents_t result;
+        result.m_version = store.version();
+        for (size_t slot = 0; slot < store.size(); ++slot) {
+            result.m_records.push_back(store.record(slot));
+        }
+        result.m_by_date = store.find_by_date_range(-1000, 1000);
+        for (const auto& place : places()) {
+            result.m_by_place.push_back(store.find_by_place(place));
+        }
+        return result;
+    }
+
+    bool matches(const weather_store_t& store) const
+    {
+        const contents_t now = of(store);
+        if (now.m_version != m_version || !same_records(now.m_records, m_records) ||
+            !same_records(now.m_by_date, m_by_date)) {
+            return false;
+        }
+        for (size_t i = 0; i < m_by_place.size(); ++i) {
+            if (!same_records(now.m_by_place[i], m_by_place[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Alle slags skrivninger i en kopi lader originalen være
+void test_copy_isolation()
+{
+    weather_store_t original = make_test_store();
+    const contents_t before = contents_t::of(original);
+
+    weather_store_t copy = original;
+    const auto created = copy.insert(make_record(-60, "Ny", 1));
+    std::vector<weathercast_t> batch;
+    for (int64_t i = 0; i < 3000; ++i) {
+        batch.push_back(make_record(10'000'000 + i, "Sted " + std::to_string(i % 3), 2)); // Nye blade sidst
+    }
+    copy.insert_batch(std::move(batch));
+    size_t moved = 0;
+    for (uint64_t id = 1; id <= 3000; id += 97, ++moved) {
+        copy.update(id, make_record(static_cast<int64_t>(id) + 7, "Flyttet igen", -1)); // Nyt tidspunkt og sted
+    }
+    copy.update(2, make_record(60, "Sted 1", 99)); // Kun temperaturen
+
+    CHECK(before.matches(original));
+    CHECK(!original.find_by_id(std::stoull(created.m_id)));
+    CHECK(original.find_by_place("Ny").empty());
+    CHECK(original.find_by_id(2)->m_temperature == 1);
+
+    CHECK(copy.size() == original.size() + 3001);
+    CHECK(copy.version() > original.version());
+    CHECK(copy.find_by_place("Ny").size() == 1);
+    CHECK(copy.find_by_place("Flyttet igen").size() == moved);
+    CHECK(copy.find_by_id(2)->m_temperature == 99);
+}
+
+// Originalen kan også ændres, mens kopien holdes, og kopien ser det ikke
+void test_original_writes()
+{
+    weather_store_t original = make_test_store();
+    const weather_store_t copy = original;
+    const contents_t before = contents_t::of(copy);
+
+    size_t moved = 0;
+    for (uint64_t id = 1; id <= 3000; id += 50, ++moved) {
+        original.update(id, make_record(-static_cast<int64_t>(id), "Ny", 0));
+    }
+    original.insert(make_record(0, "Flyttet igen", 0));
+
+    CHECK(before.matches(copy));
+    CHECK(original.find_by_place("Ny").size() == moved);
+}
+
+// Kopier af kopier: den mellemste ændres efter at have delt sine blade
+// videre, og hverken den første eller den sidste påvirkes
+void test_chained_copies()
+{
+    weather_store_t first = make_test_store();
+    first.update(10, make_record(1, "Sted 0", 10)); // Første har nu egne blade
+    weather_store_t second = first;
+    second.update(11, make_record(2, "Sted 0", 11));
+    const weather_store_t third = second;
+    const contents_t first_before = contents_t::of(first);
+    const contents_t third_before = contents_t::of(third);
+
+    // Flere skrivninger i samme blade: den første kopierer, de næste ændrer
+    // på stedet i second's egne blade
+    for (uint64_t id = 1; id <= 20; ++id) {
+        second.update(id, make_record(static_cast<int64_t>(id) * 1000, "Flyttet igen", 0));
+    }
+    second.insert(make_record(5, "Ny", 5));
+
+    CHECK(first_before.matches(first));
+    CHECK(third_before.matches(third));
+    CHECK(second.find_by_place("Flyttet igen").size() == 20);
+    CHECK(third.find_by_id(11)->m_temperature == 11);
+    CHECK(first.find_by_id(11)->m_temperature == 10);
+}
+
+// Et øjebliksbillede fra shared_weather_store_t ændres ikke af senere
+// skrivninger
+void test_published_snapshots()
+{
+    shared_weather_store_t shared{make_test_store()};
+    const auto snapshot = shared.snapshot();
+    const contents_t before = contents_t::of(*snapshot);
+
+    for (int i = 0; i < 10; ++i) {
+        shared.write([&](weather_store_t& next) {
+            next.update(static_cast<uint64_t>(i + 1), make_record(i, "Flyttet igen", i));
+            next.insert(make_record(i, "Ny", i));
+        });
+    }
+
+    CHECK(before.matches(*snapshot));
+    CHECK(shared.snapshot()->find_by_place("Ny").size() == 10);
+    CHECK(shared.snapshot()->version() > snapshot->version());
+}
+
+// De to byggesten direkte, også med blade fra view, der aldrig må skrives i
+void test_building_blocks()
+{
+    cow_vector_t<int> numbers;
+    for (int i = 0; i < 3000; ++i) {
+        numbers.push_back(i);
+    }
+    cow_vector_t<int> numbers_copy = numbers;
+    numbers_copy.set(0, -1);
+    numbers_copy.set(2999, -1);
+    numbers_copy.push_back(3000);
+    CHECK(numbers[0] == 0 && numbers[2999] == 2999 && numbers.size() == 3000);
+    CHECK(numbers_copy[0] == -1 && numbers_copy[2999] == -1 && numbers_copy.size() == 3001);
+
+    const auto data = std::make_shared<std::vector<int>>(numbers_copy.size(), 7);
+    cow_vector_t<int> viewed = cow_vector_t<int>::view(data, data->data(), data->size());
+    viewed.set(1500, 8);
+    viewed.push_back(9);
+    CHECK((*data)[1500] == 7 && data->size() == 3001);
+    CHECK(viewed[1500] == 8 && viewed[1499] == 7 && viewed[3001] == 9);
+
+    auto index = cow_sorted_index_t<int>::from_sorted(5000, [](size_t i) { return static_cast<int>(i * 2); });
+    auto index_copy = index;
+    index_copy.insert(3);
+    CHECK(index_copy.erase(4000));
+    std::vector<int> original_entries;
+    index.for_each([&](int entry) { original_entries.push_back(entry); });
+    bool unchanged = original_entries.size() == 5000;
+    for (size_t i = 0; unchanged && i < original_entries.size(); ++i) {
+        unchanged = original_entries[i] == static_cast<int>(i * 2);
+    }
+    CHECK(unchanged);
+    CHECK(index.first_not_less(3) == 4 && index_copy.first_not_less(3) == 3);
+    CHECK(index.first_not_less(3999) == 4000 && index_copy.first_not_less(3999) == 4002);
+    CHECK(index_copy.size() == 5000);
+}
+
+} // namespace
+
+int main()
+{
+    test_copy_isolation();
+    test_original_writes();
+    test_chained_copies();
+    test_published_snapshots();
+    test_building_blocks();
+    return test_result();
+}
@@ -0,0 +1,164 @@
+// Tester at ændringer til /weather/live når abonnenterne i lagerets
+// rækkefølge, også når mange samtidige PUT på samme post bliver holdbare
+// i en anden rækkefølge, end de blev skrevet: den sidste delta skal have
+// samme udgave af posten som lageret.
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+
+#include "weather_store.hpp"
+#include "weather_live.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+constexpr size_t writers = 8;
+constexpr size_t puts_per_writer = 500;
+constexpr uint64_t total_puts = writers * puts_per_writer;
+
+weather_store_t one_record_store()
+{
+    weather_store_t store;
+    store.insert(make_record(0, "Aarhus N", 0));
+    return store;
+}
+
+// PUT på ID 1 fra flere tråde som i on_put_weather: posten opdateres, og
+// ændringen får sit løbenummer under skrivelåsen. Halvdelen frigives
+// straks af skriveren (som når when_durable svarer med det samme), resten
+// af en anden tråd i omvendt rækkefølge (som tilbagekald fra loggen, der
+// når frem efter en senere skrivnings).
+void concurrent_puts(shared_weather_store_t& store, live_sequencer_t& sequencer)
+{
+    std::mutex deferred_lock;
+    std::vector<uint64_t> deferred;
+    std::atomic<size_t> running{writers};
+
+    std::thread releaser([&] {
+        for (bool last = false; !last;) {
+            last = running == 0;
+            std::vector<uint64_t> tickets;
+            {
+                std::lock_guard lock{deferred_lock};
+                tickets.swap(deferred);
+            }
+            for (auto it = tickets.rbegin(); it != tickets.rend(); ++it) {
+                sequencer.release(*it);
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            std::mt19937 random{static_cast<unsigned>(w)};
+            for (size_t i = 0; i < puts_per_writer; ++i) {
+                const auto data = make_record(0, "Aarhus N", static_cast<double>(w * puts_per_writer + i + 1));
+                uint64_t ticket = 0;
+                store.write([&](weather_store_t& next) {
+                    const auto record = next.update(1, data);
+                    ticket = sequencer.stage({{false, 1, *record, nullptr}});
+                });
+                if (random() % 2 == 0) {
+                    sequencer.release(ticket);
+                } else {
+                    std::lock_guard lock{deferred_lock};
+                    deferred.push_back(ticket);
+                }
+            }
+            --running;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    releaser.join();
+}
+
+// En ændring afleveres først, når alle tidligere er frigivet
+void test_release_waits_for_earlier()
+{
+    std::vector<uint64_t> delivered;
+    live_sequencer_t sequencer{[&](std::vector<live_change_t> changes) {
+        for (const auto& change : changes) {
+            delivered.push_back(change.m_seq);
+        }
+    }};
+    const uint64_t first = sequencer.stage({{true, 1, make_record(0, "Aarhus N", 1), nullptr}});
+    const uint64_t second = sequencer.stage(
+        {{false, 1, make_record(0, "Aarhus N", 2), nullptr}, {true, 2, make_record(0, "Aarhus N", 3), nullptr}});
+    CHECK(sequencer.stage({}) == 0);
+
+    sequencer.release(second);
+    CHECK(delivered.empty());
+    sequencer.release(first);
+    CHECK((delivered == std::vector<uint64_t>{1, 2, 3}));
+}
+
+// Uden samling: hver ændring afleveres for sig i løbenummerorden
+void test_concurrent_puts()
+{
+    shared_weather_store_t store{one_record_store()};
+    std::vector<live_change_t> delivered;
+    live_sequencer_t sequencer{[&](std::vector<live_change_t> changes) {
+        delivered.insert(delivered.end(), changes.begin(), changes.end()); // Kaldes under sekvenserens lås
+    }};
+    concurrent_puts(store, sequencer);
+
+    CHECK(delivered.size() == total_puts);
+    bool in_order = true;
+    for (size_t i = 0; i < delivered.size(); ++i) {
+        in_order = in_order && delivered[i].m_seq == i + 1;
+    }
+    CHECK(in_order);
+    CHECK(!delivered.empty() &&
+          delivered.back().m_record.m_temperature == store.snapshot()->find_by_id(1)->m_temperature);
+}
+
+// Med live_batcher_t som i serveren: rammernes løbenumre stiger, og den
+// sidste ramme har lagerets udgave
+void test_concurrent_puts_batched()
+{
+    shared_weather_store_t store{one_record_store()};
+    std::vector<std::vector<live_change_t>> frames;
+    {
+        live_batcher_t batcher{std::chrono::milliseconds{1}, [&](std::vector<live_change_t> changes) {
+            frames.push_back(std::move(changes)); // Kun batcherens tråd
+        }};
+        live_sequencer_t sequencer{[&](std::vector<live_change_t> changes) {
+            for (auto& change : changes) {
+                batcher.add(std::move(change));
+            }
+        }};
+        concurrent_puts(store, sequencer);
+    } // Batcheren sender det sidste, når den nedlægges
+
+    CHECK(!frames.empty());
+    uint64_t last_seq = 0;
+    bool increasing = true;
+    for (const auto& frame : frames) {
+        CHECK(frame.size() == 1); // Kun én post
+        increasing = increasing && frame.front().m_seq > last_seq;
+        last_seq = frame.front().m_seq;
+    }
+    CHECK(increasing);
+    CHECK(last_seq == total_puts);
+    CHECK(!frames.empty() &&
+          frames.back().front().m_record.m_temperature == store.snapshot()->find_by_id(1)->m_temperature);
+}
+
+} // namespace
+
+int main()
+{
+    test_release_waits_for_earlier();
+    test_concurrent_puts();
+    test_concurrent_puts_batched();
+    return test_result();
+}
@@ -0,0 +1,238 @@
+// Tester at et lager kommer uændret igennem save_snapshot og
+// load_snapshot (poster, indeks, version og logposition), at det kan
+// ændres bagefter, og at ødelagte filer afvises i stedet for at blive læst
+// uden for filen.
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include "weather_store.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+const std::string snapshot_path = "express_router_test_snapshot.bin";
+
+void check_same_contents(const weather_store_t& expected, const weather_store_t& actual)
+{
+    CHECK(actual.size() == expected.size());
+    CHECK(actual.version() == expected.version());
+    CHECK(same_store(actual, expected));
+    for (const uint64_t id : {uint64_t{1}, uint64_t{14}, uint64_t{2999}, uint64_t{3100}}) {
+        const auto found = actual.find_by_id(id);
+        CHECK(found && same_record(*found, *expected.find_by_id(id)));
+    }
+    CHECK(!actual.find_by_id(3050));
+    CHECK(same_records(actual.find_by_date_range(-10, 1000), expected.find_by_date_range(-10, 1000)));
+    for (const std::string place : {"Sted 3", "Sted 10", "Flyttet", "Findes ikke"}) {
+        CHECK(same_records(actual.find_by_place(place), expected.find_by_place(place)));
+    }
+}
+
+std::string read_snapshot()
+{
+    std::ifstream in{snapshot_path, std::ios::binary};
+    return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+void write_snapshot(const std::string& data)
+{
+    std::ofstream{snapshot_path, std::ios::binary | std::ios::trunc} << data;
+}
+
+bool loads(const std::string& data)
+{
+    write_snapshot(data);
+    uint64_t log_position = 0;
+    try {
+        weather_store_t::load_snapshot(snapshot_path, log_position);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+// Headerens felter ligger efter magic som 64-bit tal i filens rækkefølge:
+// format, poster, steder, ID-indeksets længde, næste ID, logposition,
+// navnenes længde og version
+void set_header_field(std::string& data, size_t field, uint64_t value)
+{
+    std::memcpy(data.data() + 8 + field * 8, &value, sizeof value);
+}
+
+uint64_t header_field(const std::string& data, size_t field)
+{
+    uint64_t value = 0;
+    std::memcpy(&value, data.data() + 8 + field * 8, sizeof value);
+    return value;
+}
+
+// Starten på de afsnit, testen ødelægger, regnet ud som i weather_store_t:
+// efter headeren på 72 bytes, hvert afsnit på en 8-byte-grænse
+struct sections_t
+{
+    size_t m_ids, m_place_ids, m_id_index, m_place_slots, m_time_index;
+
+    explicit sections_t(const std::string& data)
+    {
+        const uint64_t records = header_field(data, 1);
+        const uint64_t places = header_field(data, 2);
+        size_t at = 72;
+        auto section = [&](uint64_t count, size_t item_size) {
+            const size_t start = at;
+            at = (at + count * item_size + 7) & ~size_t{7};
+            return start;
+        };
+        m_ids = section(records, 8);
+        section(records, 8); // Tidspunkter
+        m_place_ids = section(records, 4);
+        section(records, 8); // Temperaturer
+        section(records, 4); // Luftfugtighed
+        m_id_index = section(header_field(data, 3), 8);
+        section(places, 32); // Steder
+        section(places, 8);  // Antal pr. sted
+        m_place_slots = section(records, 8);
+        m_time_index = section(records, 16);
+    }
+};
+
+template <typename T>
+T get(const std::string& data, size_t offset)
+{
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof value);
+    return value;
+}
+
+template <typename T>
+void put(std::string& data, size_t offset, T value)
+{
+    std::memcpy(data.data() + offset, &value, sizeof value);
+}
+
+// Bytter to poster på size bytes
+void swap_items(std::string& data, size_t a, size_t b, size_t size)
+{
+    std::swap_ranges(data.begin() + a, data.begin() + a + size, data.begin() + b);
+}
+
+void test_round_trip()
+{
+    const weather_store_t original = make_test_store();
+    original.save_snapshot(snapshot_path, 42);
+
+    uint64_t log_position = 0;
+    weather_store_t loaded = weather_store_t::load_snapshot(snapshot_path, log_position);
+    CHECK(log_position == 42);
+    check_same_contents(original, loaded);
+
+    // Det indlæste lager peger ind i filen, men kan stadig ændres
+    const weather_store_t before = loaded;
+    const auto created = loaded.insert(make_record(200'000, "Ny", 5));
+    CHECK(created.m_id == "3101");
+    CHECK(loaded.update(1, make_record(200'001, "Sted 3", 6)));
+    CHECK(loaded.find_by_place("Ny").size() == 1);
+    check_same_contents(original, before);
+
+    // Og gemmes igen med ændringerne
+    loaded.save_snapshot(snapshot_path, 43);
+    const weather_store_t reloaded = weather_store_t::load_snapshot(snapshot_path, log_position);
+    CHECK(log_position == 43);
+    check_same_contents(loaded, reloaded);
+}
+
+void test_empty_store()
+{
+    weather_store_t().save_snapshot(snapshot_path, 0);
+    uint64_t log_position = 1;
+    const weather_store_t loaded = weather_store_t::load_snapshot(snapshot_path, log_position);
+    CHECK(loaded.empty());
+    CHECK(log_position == 0);
+}
+
+void test_rejects_corrupt_files()
+{
+    make_test_store().save_snapshot(snapshot_path, 7);
+    const std::string good = read_snapshot();
+    CHECK(loads(good));
+
+    std::string data = good;
+    data[0] = 'X';
+    CHECK(!loads(data)); // Forkert magic
+
+    data = good;
+    set_header_field(data, 0, 1);
+    CHECK(!loads(data)); // Ukendt format
+
+    CHECK(!loads(good.substr(0, good.size() - 1))); // Afkortet
+    CHECK(!loads(good + std::string(8, '\0')));      // For lang
+    CHECK(!loads(good.substr(0, 16)));               // Kun en del af headeren
+
+    data = good;
+    set_header_field(data, 1, uint64_t{1} << 61);
+    CHECK(!loads(data)); // Antallet af poster løber over
+
+    data = good;
+    set_header_field(data, 2, ~uint64_t{0});
+    CHECK(!loads(data)); // Antallet af steder løber over
+}
+
+// Kolonner og indeks, der ville give læsninger uden for kolonnerne eller
+// forkerte opslag, afvises
+void test_rejects_corrupt_columns()
+{
+    make_test_store().save_snapshot(snapshot_path, 7);
+    const std::string good = read_snapshot();
+    const sections_t at{good};
+
+    std::string data = good;
+    put(data, at.m_place_ids, static_cast<uint32_t>(header_field(good, 2)));
+    CHECK(!loads(data)); // Sted uden for stedtabellen
+
+    data = good;
+    put(data, at.m_id_index, header_field(good, 1));
+    CHECK(!loads(data)); // ID-indekset peger uden for kolonnerne
+
+    data = good;
+    swap_items(data, at.m_id_index, at.m_id_index + 8, 8);
+    CHECK(!loads(data)); // ID-indekset peger på en anden posts plads
+
+    data = good;
+    put(data, at.m_ids, uint64_t{3050}); // Et hul i ID-rækken
+    CHECK(!loads(data)); // ID-kolonnen passer ikke med indekset
+
+    data = good;
+    set_header_field(data, 4, 3000);
+    CHECK(!loads(data)); // Næste ID er allerede brugt
+
+    data = good;
+    swap_items(data, at.m_place_slots, at.m_place_slots + 8, 8);
+    CHECK(!loads(data)); // Stedsindekset er ikke sorteret
+
+    data = good;
+    swap_items(data, at.m_time_index, at.m_time_index + 16, 16);
+    CHECK(!loads(data)); // Tidsindekset er ikke sorteret
+
+    data = good;
+    put(data, at.m_time_index, get<int64_t>(good, at.m_time_index) - 1);
+    CHECK(!loads(data)); // Tidsindekset passer ikke med kolonnen
+}
+
+} // namespace
+
+int main()
+{
+    test_round_trip();
+    test_empty_store();
+    test_rejects_corrupt_files();
+    test_rejects_corrupt_columns();
+    std::remove(snapshot_path.c_str());
+    return test_result();
+}
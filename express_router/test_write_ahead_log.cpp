@@ -0,0 +1,188 @@
+// Tester afspilningen af write-ahead-loggen: alt holdbart kommer tilbage
+// efter en genstart, en afrevet eller beskadiget hale (som efter et
+// strømsvigt midt i en skrivning) skæres væk uden at tage hele poster med,
+// og compact fjerner kun det, snapshottet dækker, også mens der skrives.
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "weather_store.hpp"
+#include "write_ahead_log.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+const std::string log_path = "express_router_test_wal.log";
+constexpr std::chrono::milliseconds commit_interval{1};
+
+// Indsætter count poster i store og logger dem, som POST /weather
+void insert_logged(weather_store_t& store, write_ahead_log_t& log, int64_t first, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const auto minutes = first + static_cast<int64_t>(i);
+        log.log_insert(store.insert(
+            make_record(minutes, "Sted " + std::to_string(minutes % 5), static_cast<double>(minutes))));
+    }
+}
+
+off_t file_size()
+{
+    struct stat info{};
+    return ::stat(log_path.c_str(), &info) == 0 ? info.st_size : -1;
+}
+
+// Alt der er sync'et, kommer tilbage i samme rækkefølge, med opdateringer
+void test_replay()
+{
+    std::remove(log_path.c_str());
+    weather_store_t written;
+    {
+        write_ahead_log_t log{log_path, commit_interval, written};
+        insert_logged(written, log, 0, 100);
+        for (uint64_t id = 1; id <= 100; id += 7) {
+            log.log_update(*written.update(id, make_record(1000 + static_cast<int64_t>(id), "Flyttet", -3)));
+        }
+        CHECK(log.sync());
+    }
+
+    weather_store_t replayed;
+    write_ahead_log_t log{log_path, commit_interval, replayed};
+    CHECK(log.replayed() == 115);
+    CHECK(log.last_lsn() == 115);
+    CHECK(same_store(written, replayed));
+}
+
+// En hale revet over midt i en post fjernes; de hele poster før den
+// bevares, og nye poster skrives lige efter dem
+void test_torn_tail()
+{
+    std::remove(log_path.c_str());
+    weather_store_t written;
+    {
+        write_ahead_log_t log{log_path, commit_interval, written};
+        insert_logged(written, log, 0, 10);
+        CHECK(log.sync());
+    }
+    const off_t complete = file_size();
+    {
+        weather_store_t restarted;
+        write_ahead_log_t log{log_path, commit_interval, restarted};
+        insert_logged(restarted, log, 10, 1);
+        CHECK(log.sync());
+    }
+    CHECK(::truncate(log_path.c_str(), file_size() - 3) == 0); // Den sidste post er halv
+
+    weather_store_t replayed;
+    {
+        write_ahead_log_t log{log_path, commit_interval, replayed};
+        CHECK(log.replayed() == 10);
+        CHECK(log.last_lsn() == 10);
+        CHECK(file_size() == complete);
+        insert_logged(replayed, log, 20, 1);
+        CHECK(log.sync());
+    }
+
+    weather_store_t again;
+    write_ahead_log_t log{log_path, commit_interval, again};
+    CHECK(log.replayed() == 11);
+    CHECK(same_store(replayed, again));
+    CHECK(again.find_by_id(11) && again.find_by_id(11)->m_dateTime.m_minutes == 20);
+}
+
+// En post med forkert kontrolsum behandles som en afrevet hale
+void test_corrupt_tail()
+{
+    std::remove(log_path.c_str());
+    weather_store_t written;
+    {
+        write_ahead_log_t log{log_path, commit_interval, written};
+        insert_logged(written, log, 0, 5);
+        CHECK(log.sync());
+    }
+    const int fd = ::open(log_path.c_str(), O_WRONLY);
+    const char garbage = '\x7f';
+    CHECK(fd >= 0 && ::pwrite(fd, &garbage, 1, file_size() - 1) == 1);
+    ::close(fd);
+
+    weather_store_t replayed;
+    write_ahead_log_t log{log_path, commit_interval, replayed};
+    CHECK(log.replayed() == 4);
+    CHECK(replayed.size() == 4);
+}
+
+// Poster et snapshot dækker, springes over ved afspilning
+void test_covered()
+{
+    std::remove(log_path.c_str());
+    weather_store_t written;
+    {
+        write_ahead_log_t log{log_path, commit_interval, written};
+        insert_logged(written, log, 0, 20);
+        CHECK(log.sync());
+    }
+
+    weather_store_t snapshot;
+    for (size_t slot = 0; slot < 12; ++slot) {
+        snapshot.insert(written.record(slot));
+    }
+    write_ahead_log_t log{log_path, commit_interval, snapshot, 12};
+    CHECK(log.replayed() == 8);
+    CHECK(log.last_lsn() == 20);
+    CHECK(same_store(written, snapshot));
+}
+
+// compact mens en anden tråd skriver: intet logget efter covered går tabt,
+// og LSN fortsætter
+void test_compact_while_writing()
+{
+    std::remove(log_path.c_str());
+    weather_store_t written;
+    {
+        write_ahead_log_t log{log_path, commit_interval, written};
+        insert_logged(written, log, 0, 1000);
+        CHECK(log.sync());
+
+        std::atomic<bool> writing{true};
+        std::thread writer([&] {
+            for (int64_t minutes = 1000; writing; ++minutes) {
+                insert_logged(written, log, minutes, 1);
+            }
+        });
+        for (int i = 0; i < 3; ++i) {
+            log.compact(1000);
+        }
+        writing = false;
+        writer.join();
+        CHECK(log.sync());
+    }
+
+    weather_store_t snapshot;
+    for (size_t slot = 0; slot < 1000; ++slot) {
+        snapshot.insert(written.record(slot));
+    }
+    write_ahead_log_t log{log_path, commit_interval, snapshot, 1000};
+    CHECK(log.replayed() == written.size() - 1000);
+    CHECK(log.last_lsn() == written.size());
+    CHECK(same_store(written, snapshot));
+}
+
+} // namespace
+
+int main()
+{
+    test_replay();
+    test_torn_tail();
+    test_corrupt_tail();
+    test_covered();
+    test_compact_while_writing();
+    std::remove(log_path.c_str());
+    return test_result();
+}
@@ -0,0 +1,238 @@
+// Binært kolonneformat for vejrudsigter, til klienter der sender
+//   Accept: application/x-weather-columns
+// En ramme er en header efterfulgt af afsnittene herunder, hvert startende
+// på en 8-byte-grænse, så de kan læses direkte som typede arrays (fx
+// Float64Array i JavaScript). Tal er i værtens byte-orden (little-endian på
+// x86), som i snapshot-filen.
+//
+//   weather_columns_header_t
+//   uint64_t id[records]
+//   int64_t  minutes[records]      Minutter siden 1970-01-01 00:00
+//   double   temperature[records]
+//   uint32_t place[records]        Plads i stedtabellen
+//   int32_t  humidity[records]
+//   uint8_t  created[records]      Kun i deltaer og resync-svar: 1 = oprettet, 0 = ændret
+//   double   lat[places]
+//   double   lon[places]
+//   uint32_t name_end[places]      Slutningen af stedets navn i names
+//   char     names[names_size]     UTF-8, uden afslutning
+//
+// Hvert sted står kun én gang, så en post fylder 32 bytes mod omkring
+// 170 i JSON.
+//
+// Et streamet svar (GET /weather?stream=1) starter med en header alene,
+// med kind stream og det samlede antal poster i m_records, efterfulgt af
+// almindelige records-rammer på hver højst et par hundrede poster. Hver
+// ramme har sin egen stedtabel, så den kan læses for sig, og er fyldt op
+// med nuller til en 8-byte-grænse, så den næste også starter på én.
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+#include "weather_store.hpp"
+
+constexpr char weather_columns_media_type[] = "application/x-weather-columns";
+
+enum class weather_columns_kind_t : uint16_t
+{
+    records = 0, // Svar på GET
+    delta = 1,   // Ændringer fra /weather/live
+    resync = 2,  // Svar på en resync; anvendes uanset klientens seneste seq
+    stream = 3   // Start på et streamet svar; records-rammerne følger efter
+};
+
+struct weather_columns_header_t
+{
+    char m_magic[4];  // "WCOL"
+    uint16_t m_version;
+    uint16_t m_kind;  // weather_columns_kind_t
+    uint32_t m_records;
+    uint32_t m_places;
+    uint64_t m_seq;   // Højeste løbenummer i en delta eller resync, ellers 0
+    uint64_t m_names_size;
+};
+
+// Samler poster og skriver dem som én ramme
+class weather_columns_writer_t
+{
+public:
+    explicit weather_columns_writer_t(size_t expected_records = 0)
+    {
+        m_ids.reserve(expected_records);
+        m_minutes.reserve(expected_records);
+        m_temperatures.reserve(expected_records);
+        m_places.reserve(expected_records);
+        m_humidities.reserve(expected_records);
+    }
+
+    void add(const weathercast_t& record, bool created = false)
+    {
+        m_ids.push_back(weather_store_t::parse_id(record.m_id).value_or(0));
+        m_minutes.push_back(record.m_dateTime.m_minutes);
+        m_temperatures.push_back(record.m_temperature);
+        m_places.push_back(place_index(record.m_place));
+        m_humidities.push_back(record.m_humidity);
+        m_created.push_back(created ? 1 : 0);
+    }
+
+    std::string frame(weather_columns_kind_t kind = weather_columns_kind_t::records, uint64_t seq = 0) const
+    {
+        weather_columns_header_t header = make_header(kind, m_ids.size());
+        header.m_places = static_cast<uint32_t>(m_lats.size());
+        header.m_seq = seq;
+        header.m_names_size = m_names.size();
+
+        std::string out;
+        out.reserve(sizeof header + m_ids.size() * 33 + m_lats.size() * 20 + m_names.size() + 64);
+        append(out, &header, sizeof header);
+        append_section(out, m_ids);
+        append_section(out, m_minutes);
+        append_section(out, m_temperatures);
+        append_section(out, m_places);
+        append_section(out, m_humidities);
+        if (kind != weather_columns_kind_t::records) {
+            append_section(out, m_created);
+        }
+        append_section(out, m_lats);
+        append_section(out, m_lons);
+        append_section(out, m_name_ends);
+        append_section(out, m_names);
+        return out;
+    }
+
+    static weather_columns_header_t make_header(weather_columns_kind_t kind, size_t records)
+    {
+        weather_columns_header_t header{};
+        memcpy(header.m_magic, "WCOL", 4);
+        header.m_version = 1;
+        header.m_kind = static_cast<uint16_t>(kind);
+        header.m_records = static_cast<uint32_t>(records);
+        return header;
+    }
+
+private:
+    std::vector<uint64_t> m_ids;
+    std::vector<int64_t> m_minutes;
+    std::vector<double> m_temperatures;
+    std::vector<uint32_t> m_places;
+    std::vector<int32_t> m_humidities;
+    std::vector<uint8_t> m_created;
+
+    std::vector<double> m_lats;
+    std::vector<double> m_lons;
+    std::vector<uint32_t> m_name_ends;
+    std::string m_names;
+    std::unordered_map<std::string, uint32_t> m_place_index; // Navn + koordinater -> plads
+
+    uint32_t place_index(const place_t& place)
+    {
+        std::string key = place.m_name;
+        key.append(reinterpret_cast<const char*>(&place.m_lat), sizeof place.m_lat);
+        key.append(reinterpret_cast<const char*>(&place.m_lon), sizeof place.m_lon);
+        const auto [it, inserted] = m_place_index.emplace(std::move(key), static_cast<uint32_t>(m_lats.size()));
+        if (inserted) {
+            m_lats.push_back(place.m_lat);
+            m_lons.push_back(place.m_lon);
+            m_names += place.m_name;
+            m_name_ends.push_back(static_cast<uint32_t>(m_names.size()));
+        }
+        return it->second;
+    }
+
+    static void append(std::string& out, const void* data, size_t size)
+    {
+        out.append(static_cast<const char*>(data), size);
+    }
+
+    template <typename CONTAINER>
+    static void append_section(std::string& out, const CONTAINER& values)
+    {
+        out.append((8 - out.size() % 8) % 8, '\0'); // 8-byte-grænse
+        append(out, values.data(), values.size() * sizeof(values[0]));
+    }
+};
+
+inline std::string weather_to_columns(const std::vector<weathercast_t>& records)
+{
+    weather_columns_writer_t writer{records.size()};
+    for (const auto& record : records) {
+        writer.add(record);
+    }
+    return writer.frame();
+}
+
+inline std::string weather_to_columns(
+    const weather_store_t& store, weather_store_t::slot_t first, weather_store_t::slot_t last)
+{
+    weather_columns_writer_t writer{last - first};
+    for (auto slot = first; slot < last; ++slot) {
+        writer.add(store.record(slot));
+    }
+    return writer.frame();
+}
+
+// Headeren, et streamet svar med records poster i alt starter med
+inline std::string weather_columns_stream_header(size_t records)
+{
+    const auto header = weather_columns_writer_t::make_header(weather_columns_kind_t::stream, records);
+    return std::string(reinterpret_cast<const char*>(&header), sizeof header);
+}
+
+// Et q i Accept-headeren. from_chars, så et decimalkomma fra localen ikke
+// gør "0.5" til 0 (som strtod ville); noget der ikke er et tal, giver 0.
+inline double parse_qvalue(std::string_view value)
+{
+    const auto end = value.find_last_not_of(" \t");
+    value = end == std::string_view::npos ? std::string_view{} : value.substr(0, end + 1);
+    double q = 0;
+    const auto [last, error] = std::from_chars(value.data(), value.data() + value.size(), q);
+    if (error != std::errc{} || last != value.data() + value.size() || !(q >= 0)) {
+        return 0;
+    }
+    return std::min(q, 1.0);
+}
+
+// Om Accept-headeren foretrækker kolonneformatet frem for JSON. Det skal
+// nævnes udtrykkeligt med q > 0 og mindst lige så højt q som JSON
+// (application/json, application/* eller */*).
+inline bool prefers_columns(std::string_view accept)
+{
+    double columns_q = 0;
+    double json_q = 0;
+    while (!accept.empty()) {
+        const auto comma = accept.find(',');
+        std::string_view range = accept.substr(0, comma);
+        accept = comma == std::string_view::npos ? std::string_view{} : accept.substr(comma + 1);
+
+        double q = 1;
+        const auto semicolon = range.find(';');
+        std::string_view params = semicolon == std::string_view::npos ? std::string_view{} : range.substr(semicolon + 1);
+        range = range.substr(0, semicolon);
+        while (!params.empty()) {
+            const auto next = params.find(';');
+            std::string_view param = params.substr(0, next);
+            params = next == std::string_view::npos ? std::string_view{} : params.substr(next + 1);
+            const auto start = param.find_first_not_of(" \t");
+            if (start != std::string_view::npos && param.substr(start, 2) == "q=") {
+                q = parse_qvalue(param.substr(start + 2));
+            }
+        }
+
+        const auto start = range.find_first_not_of(" \t");
+        const auto end = range.find_last_not_of(" \t");
+        range = start == std::string_view::npos ? std::string_view{} : range.substr(start, end - start + 1);
+        if (range == weather_columns_media_type) {
+            columns_q = std::max(columns_q, q);
+        } else if (range == "application/json" || range == "application/*" || range == "*/*") {
+            json_q = std::max(json_q, q);
+        }
+    }
+    return columns_q > 0 && columns_q >= json_q;
+}
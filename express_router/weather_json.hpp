@@ -0,0 +1,473 @@
+// JSON for vejrudsigter uden om json_dto. Giver præcis de samme bytes som
+// json_dto::to_json (RapidJSON's Writer uden mellemrum), men skriver
+// direkte i en streng i stedet for først at bygge et RapidJSON-dokument:
+// nøglerne ligger færdige som faste tekststykker, tal skrives med
+// RapidJSON's egen dtoa (så decimalerne bliver de samme), og dato og
+// klokkeslæt skrives ciffer for ciffer. weather_from_json læser den anden
+// vej og falder tilbage til json_dto ved alt usædvanligt.
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <array>
+#include <limits>
+#include <rapidjson/internal/dtoa.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "weather_store.hpp"
+
+// Omtrentlig størrelse af én post, til reserve()
+constexpr size_t weather_json_record_size = 160;
+
+// Tilføjer text som JSON-streng, med samme escaping som RapidJSON
+inline void append_json_string(std::string& out, std::string_view text)
+{
+    out += '"';
+    size_t plain = 0; // Starten på den del, der ikke er skrevet endnu
+    for (size_t i = 0; i < text.size(); ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(text, plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            static constexpr char hex[] = "0123456789ABCDEF";
+            const char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out.append(escaped, sizeof escaped);
+        }
+        }
+    }
+    out.append(text, plain, std::string_view::npos);
+    out += '"';
+}
+
+inline void append_json_number(std::string& out, double value)
+{
+    if (!std::isfinite(value)) {
+        throw std::invalid_argument("NaN og uendelig kan ikke skrives som JSON");
+    }
+    char buffer[32];
+    const char* end = rapidjson::internal::dtoa(value, buffer);
+    out.append(buffer, end - buffer);
+}
+
+inline void append_json_number(std::string& out, int value)
+{
+    char buffer[16];
+    const auto result = std::to_chars(buffer, buffer + sizeof buffer, value);
+    out.append(buffer, result.ptr - buffer);
+}
+
+// n som præcis width cifre (n < 10^width)
+inline void append_digits(std::string& out, unsigned n, int width)
+{
+    char buffer[4];
+    for (int i = width - 1; i >= 0; --i) {
+        buffer[i] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    }
+    out.append(buffer, width);
+}
+
+// Tilføjer record som JSON-objekt til out
+inline void append_weather_json(std::string& out, const weathercast_t& record)
+{
+    // ID udelades kun, hvis det er tomt (standardværdien i json_io)
+    if (!record.m_id.empty()) {
+        out += R"({"ID":)";
+        append_json_string(out, record.m_id);
+        out += R"json(,"Tidspunkt (dato og klokkeslæt)":{"Dato":")json";
+    } else {
+        out += R"json({"Tidspunkt (dato og klokkeslæt)":{"Dato":")json";
+    }
+
+    int64_t y;
+    unsigned m, d;
+    record.m_dateTime.date_parts(y, m, d);
+    if (y >= 0 && y <= 9999) {
+        append_digits(out, static_cast<unsigned>(y), 4);
+        out += '.';
+        append_digits(out, m, 2);
+        out += '.';
+        append_digits(out, d, 2);
+    } else {
+        out += record.m_dateTime.date_string(); // Kun tegn, der ikke skal escapes
+    }
+    out += R"(","Klokkeslæt":")";
+    const int minutes = record.m_dateTime.minute_of_day();
+    append_digits(out, static_cast<unsigned>(minutes / 60), 2);
+    out += ':';
+    append_digits(out, static_cast<unsigned>(minutes % 60), 2);
+
+    out += R"("},"Sted":{"Navn":)";
+    append_json_string(out, record.m_place.m_name);
+    out += R"(,"Lat":)";
+    append_json_number(out, record.m_place.m_lat);
+    out += R"(,"Lon":)";
+    append_json_number(out, record.m_place.m_lon);
+    out += R"(},"Temperatur":)";
+    append_json_number(out, record.m_temperature);
+    out += R"(,"Luftfugtighed":)";
+    append_json_number(out, record.m_humidity);
+    out += '}';
+}
+
+// Som json_dto::to_json(record)
+inline std::string weather_to_json(const weathercast_t& record)
+{
+    std::string out;
+    out.reserve(weather_json_record_size + record.m_place.m_name.size());
+    append_weather_json(out, record);
+    return out;
+}
+
+// Som json_dto::to_json(records)
+inline std::string weather_to_json(const std::vector<weathercast_t>& records)
+{
+    std::string out;
+    out.reserve(2 + records.size() * (weather_json_record_size + 1));
+    out += '[';
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (i != 0) {
+            out += ',';
+        }
+        append_weather_json(out, records[i]);
+    }
+    out += ']';
+    return out;
+}
+
+// JSON-arrayet med posterne i pladserne [first, last), i samme form som
+// json_dto::to_json giver for en vektor af dem, men skrevet direkte fra
+// lagerets kolonner
+inline std::string weather_to_json(
+    const weather_store_t& store, weather_store_t::slot_t first, weather_store_t::slot_t last)
+{
+    std::string out;
+    out.reserve(2 + (last - first) * (weather_json_record_size + 1));
+    out += '[';
+    for (auto slot = first; slot < last; ++slot) {
+        if (slot != first) {
+            out += ',';
+        }
+        append_weather_json(out, store.record(slot));
+    }
+    out += ']';
+    return out;
+}
+
+// Hurtig indlæsning af én vejrudsigt uden RapidJSON-dokument. Klarer den
+// almindelige form (kendte nøgler i vilkårlig rækkefølge, strenge uden
+// escapes, tal med højst 15 betydende cifre); alt andet, også fejl, giver
+// nullopt, så json_dto kan tage sig af det med sine egne fejlbeskeder.
+// Inden for den form giver RapidJSON's standardparsing korrekt afrundede
+// tal, så resultatet er det samme som json_dto::from_json<weathercast_t>.
+class weather_json_parser_t
+{
+public:
+    static std::optional<weathercast_t> parse(std::string_view json)
+    {
+        weather_json_parser_t parser{json};
+        weathercast_t record;
+        if (!parser.parse_record(record) || !parser.at_end()) {
+            return std::nullopt;
+        }
+        return record;
+    }
+
+private:
+    const char* m_p;
+    const char* const m_end;
+
+    explicit weather_json_parser_t(std::string_view json)
+        : m_p(json.data())
+        , m_end(json.data() + json.size())
+    {}
+
+    void skip_whitespace()
+    {
+        while (m_p != m_end && (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t')) {
+            ++m_p;
+        }
+    }
+
+    bool at_end()
+    {
+        skip_whitespace();
+        return m_p == m_end;
+    }
+
+    bool consume(char c)
+    {
+        skip_whitespace();
+        if (m_p == m_end || *m_p != c) {
+            return false;
+        }
+        ++m_p;
+        return true;
+    }
+
+    // Første '"', '\\' eller kontroltegn fra p; 16 bytes ad gangen med SSE2
+    static const char* find_string_special(const char* p, const char* end)
+    {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+        for (; end - p >= 16; p += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control)); // chunk <= 0x1F
+            if (const int mask = _mm_movemask_epi8(special)) {
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+        }
+#endif
+        for (; p != end; ++p) {
+            const auto c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\' || c < 0x20) {
+                break;
+            }
+        }
+        return p;
+    }
+
+    // En streng uden escapes; værdien peger ind i kroppen
+    bool parse_string(std::string_view& value)
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        const char* close = find_string_special(m_p, m_end);
+        if (close == m_end || *close != '"') {
+            return false; // Escapes og fejl klares af json_dto
+        }
+        value = std::string_view(m_p, static_cast<size_t>(close - m_p));
+        m_p = close + 1;
+        return true;
+    }
+
+    // Et JSON-tal, som RapidJSON ville læse det, eller false hvis det ikke
+    // sikkert giver samme double. integer er sat, hvis tallet er et heltal.
+    bool parse_number(double& value, std::optional<int64_t>& integer)
+    {
+        skip_whitespace();
+        const char* start = m_p;
+        const char* p = m_p;
+        if (p != m_end && *p == '-') {
+            ++p;
+        }
+        if (p == m_end || *p < '0' || *p > '9' || (*p == '0' && p + 1 != m_end && p[1] >= '0' && p[1] <= '9')) {
+            return false; // Intet ciffer eller foranstillet nul
+        }
+        int digits = 0;
+        bool significant = false;
+        for (; p != m_end && *p >= '0' && *p <= '9'; ++p) {
+            significant = significant || *p != '0';
+            digits += significant;
+        }
+        bool fraction = false;
+        int fraction_digits = 0;
+        if (p != m_end && *p == '.') {
+            fraction = true;
+            ++p;
+            const char* first = p;
+            for (; p != m_end && *p >= '0' && *p <= '9'; ++p) {
+                significant = significant || *p != '0';
+                digits += significant;
+                ++fraction_digits;
+            }
+            if (p == first) {
+                return false;
+            }
+        }
+        int exponent = 0;
+        bool has_exponent = false;
+        if (p != m_end && (*p == 'e' || *p == 'E')) {
+            has_exponent = true;
+            ++p;
+            bool negative = false;
+            if (p != m_end && (*p == '+' || *p == '-')) {
+                negative = *p == '-';
+                ++p;
+            }
+            const char* first = p;
+            for (; p != m_end && *p >= '0' && *p <= '9' && exponent < 1000; ++p) {
+                exponent = exponent * 10 + (*p - '0');
+            }
+            if (p == first || (p != m_end && *p >= '0' && *p <= '9')) {
+                return false;
+            }
+            exponent = negative ? -exponent : exponent;
+        }
+        // Højst 15 cifre og en lille eksponent: både RapidJSON og from_chars
+        // giver det korrekt afrundede tal
+        if (digits > 15 || exponent - fraction_digits < -22 || exponent - fraction_digits > 22) {
+            return false;
+        }
+        const auto [end, error] = std::from_chars(start, p, value);
+        if (error != std::errc{} || end != p) {
+            return false;
+        }
+        integer.reset();
+        if (!fraction && !has_exponent) {
+            int64_t n = 0;
+            if (std::from_chars(start, p, n).ec == std::errc{}) {
+                integer = n;
+            }
+            if (integer == 0 && *start == '-') {
+                return false; // RapidJSON læser "-0" som heltallet 0, ikke -0.0
+            }
+        }
+        m_p = p;
+        return true;
+    }
+
+    bool parse_double(double& value)
+    {
+        std::optional<int64_t> integer;
+        return parse_number(value, integer);
+    }
+
+    bool parse_int(int& value)
+    {
+        double ignored;
+        std::optional<int64_t> integer;
+        if (!parse_number(ignored, integer) || !integer ||
+            *integer < std::numeric_limits<int>::min() || *integer > std::numeric_limits<int>::max()) {
+            return false; // json_dto kræver et tal, der passer i en int
+        }
+        value = static_cast<int>(*integer);
+        return true;
+    }
+
+    // Et objekt, hvor member(nøgle) læser værdien og giver false ved noget
+    // uventet. Hver nøgle i keys må kun optræde én gang; bit i i seen
+    // sættes for keys[i].
+    template <size_t N, typename F>
+    bool parse_object(const std::array<std::string_view, N>& keys, unsigned& seen, F&& member)
+    {
+        seen = 0;
+        if (!consume('{')) {
+            return false;
+        }
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            std::string_view key;
+            if (!parse_string(key) || !consume(':')) {
+                return false;
+            }
+            size_t index = 0;
+            while (index < N && keys[index] != key) {
+                ++index;
+            }
+            if (index == N || (seen & (1u << index))) {
+                return false; // Ukendt eller gentaget nøgle
+            }
+            seen |= 1u << index;
+            if (!member(index)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    bool parse_record(weathercast_t& record)
+    {
+        static constexpr std::array<std::string_view, 5> keys{
+            "ID", "Tidspunkt (dato og klokkeslæt)", "Sted", "Temperatur", "Luftfugtighed"};
+        unsigned seen = 0;
+        const bool ok = parse_object(keys, seen, [&](size_t index) {
+            switch (index) {
+            case 0: {
+                std::string_view id;
+                if (!parse_string(id)) {
+                    return false;
+                }
+                record.m_id = std::string(id);
+                return true;
+            }
+            case 1: return parse_date_time(record.m_dateTime);
+            case 2: return parse_place(record.m_place);
+            case 3: return parse_double(record.m_temperature);
+            default: return parse_int(record.m_humidity);
+            }
+        });
+        return ok && (seen | 1u) == 0b11111; // ID er valgfrit
+    }
+
+    bool parse_date_time(dateTime_t& value)
+    {
+        static constexpr std::array<std::string_view, 2> keys{"Dato", "Klokkeslæt"};
+        std::string_view date;
+        std::string_view time;
+        unsigned seen = 0;
+        const bool ok = parse_object(keys, seen, [&](size_t index) {
+            return parse_string(index == 0 ? date : time);
+        });
+        if (!ok || seen != 0b11) {
+            return false;
+        }
+        // Ugyldig dato eller klokkeslæt: json_dto giver fejlbeskeden
+        const auto day = dateTime_t::try_parse_date(date);
+        if (!day) {
+            return false;
+        }
+        try {
+            value = dateTime_t{*day * dateTime_t::minutes_per_day + dateTime_t::parse_time(time)};
+        } catch (const std::invalid_argument&) {
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_place(place_t& value)
+    {
+        static constexpr std::array<std::string_view, 3> keys{"Navn", "Lat", "Lon"};
+        unsigned seen = 0;
+        const bool ok = parse_object(keys, seen, [&](size_t index) {
+            switch (index) {
+            case 0: {
+                std::string_view name;
+                if (!parse_string(name)) {
+                    return false;
+                }
+                value.m_name = std::string(name);
+                return true;
+            }
+            case 1: return parse_double(value.m_lat);
+            default: return parse_double(value.m_lon);
+            }
+        });
+        return ok && seen == 0b111;
+    }
+};
+
+// Som json_dto::from_json<weathercast_t>(json), med samme resultat og samme
+// fejl, men uden RapidJSON-dokument i det almindelige tilfælde
+inline weathercast_t weather_from_json(std::string_view json)
+{
+    if (auto record = weather_json_parser_t::parse(json)) {
+        return std::move(*record);
+    }
+    return json_dto::from_json<weathercast_t>(std::string{json});
+}
@@ -0,0 +1,641 @@
+// Ændringer til /weather/live på vej fra lageret til abonnenterne: de får
+// løbenumre i lagerets rækkefølge (live_sequencer_t), samles til én
+// delta-ramme pr. interval (live_batcher_t) og sendes til de forbindelser,
+// der abonnerer på dem (ws_registry_t, send_routes), hver med sin egen
+// begrænsede kø (live_subscriber_t).
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <optional>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <json_dto/pub.hpp>
+
+#include "weather_store.hpp"
+#include "weather_columns.hpp"
+
+// En oprettet eller ændret post, som den sendes til /weather/live
+struct live_change_t
+{
+    bool m_created;
+    uint64_t m_id;
+    weathercast_t m_record; // Til kolonneformatet og til at finde abonnenterne
+    std::shared_ptr<const std::string> m_json;
+    uint64_t m_seq = 0; // Løbenummer, tildelt af live_sequencer_t
+};
+
+// Giver ændringer løbenumre i samme rækkefølge som lageret og afleverer
+// dem i løbenummerorden. stage kaldes under lagerets skrivelås; release
+// kaldes, når ændringerne er skrevet til disken, og kan komme i en anden
+// rækkefølge og fra flere tråde. En ændring holdes tilbage, til alle
+// tidligere er frigivet, så en ældre udgave af en post aldrig afleveres
+// efter en nyere.
+class live_sequencer_t
+{
+public:
+    using deliver_t = std::function<void(std::vector<live_change_t>)>;
+
+    explicit live_sequencer_t(deliver_t deliver)
+        : m_deliver(std::move(deliver))
+    {}
+
+    live_sequencer_t(const live_sequencer_t&) = delete;
+    live_sequencer_t& operator=(const live_sequencer_t&) = delete;
+
+    // Tildeler changes løbenumre og giver kvitteringen til release, eller
+    // 0 hvis changes er tom
+    uint64_t stage(std::vector<live_change_t> changes)
+    {
+        if (changes.empty()) {
+            return 0;
+        }
+        std::lock_guard lock{m_lock};
+        const uint64_t ticket = m_seq + 1;
+        for (auto& change : changes) {
+            change.m_seq = ++m_seq;
+        }
+        m_staged.push_back({std::move(changes), false});
+        return ticket;
+    }
+
+    // Frigiver ændringerne med denne kvittering og afleverer dem og alle
+    // efterfølgende, der allerede er frigivet. deliver kaldes under låsen,
+    // så afleveringerne ikke kan overhale hinanden.
+    void release(uint64_t ticket)
+    {
+        if (ticket == 0) {
+            return;
+        }
+        std::lock_guard lock{m_lock};
+        const auto it = std::lower_bound(m_staged.begin(), m_staged.end(), ticket,
+            [](const staged_t& staged, uint64_t seq) { return staged.m_changes.front().m_seq < seq; });
+        it->m_released = true;
+        while (!m_staged.empty() && m_staged.front().m_released) {
+            auto changes = std::move(m_staged.front().m_changes);
+            m_staged.pop_front();
+            m_deliver(std::move(changes));
+        }
+    }
+
+private:
+    struct staged_t
+    {
+        std::vector<live_change_t> m_changes;
+        bool m_released;
+    };
+
+    const deliver_t m_deliver;
+
+    std::mutex m_lock; // Beskytter alt herunder
+    std::deque<staged_t> m_staged; // I løbenummerorden
+    uint64_t m_seq = 0; // Senest tildelte løbenummer
+};
+
+// Samler ændringer til /weather/live og afleverer dem samlet højst
+// interval efter den første ændring, så de kan sendes som én delta-ramme.
+// Flere ændringer af samme post inden for et interval giver kun den
+// seneste udgave (med dens løbenummer); en post oprettet og ændret i samme
+// interval står som oprettet. Rammerne bygges på batcherens egen tråd.
+class live_batcher_t
+{
+public:
+    using send_t = std::function<void(std::vector<live_change_t>)>;
+
+    live_batcher_t(std::chrono::milliseconds interval, send_t send)
+        : m_interval(interval)
+        , m_send(std::move(send))
+        , m_thread([this] { run(); })
+    {}
+
+    live_batcher_t(const live_batcher_t&) = delete;
+    live_batcher_t& operator=(const live_batcher_t&) = delete;
+
+    ~live_batcher_t()
+    {
+        {
+            std::lock_guard lock{m_lock};
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join(); // Sender det sidste inden tråden stopper
+    }
+
+    // Ændringerne skal komme i løbenummerorden
+    void add(live_change_t change)
+    {
+        std::lock_guard lock{m_lock};
+        if (m_pending.empty()) {
+            m_first_pending = std::chrono::steady_clock::now();
+            m_wake.notify_all();
+        }
+        const auto [it, inserted] = m_position.emplace(change.m_id, m_pending.size());
+        if (inserted) {
+            m_pending.push_back(std::move(change));
+        } else {
+            auto& pending = m_pending[it->second];
+            pending.m_record = std::move(change.m_record);
+            pending.m_json = std::move(change.m_json);
+            pending.m_seq = change.m_seq;
+        }
+    }
+
+    uint64_t frames() const { return m_frames; }
+    uint64_t changes() const { return m_changes; }
+
+private:
+    const std::chrono::milliseconds m_interval;
+    const send_t m_send;
+
+    std::mutex m_lock; // Beskytter alt herunder
+    std::condition_variable m_wake;
+    std::vector<live_change_t> m_pending;
+    std::unordered_map<uint64_t, size_t> m_position; // ID -> plads i m_pending
+    std::chrono::steady_clock::time_point m_first_pending;
+    bool m_stop = false;
+
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_changes{0};
+    std::thread m_thread; // Sidst, så den startes efter resten er klar
+
+    void run()
+    {
+        std::unique_lock lock{m_lock};
+        for (;;) {
+            m_wake.wait(lock, [&] { return m_stop || !m_pending.empty(); });
+            if (m_stop && m_pending.empty()) {
+                return;
+            }
+            m_wake.wait_until(lock, m_first_pending + m_interval, [&] { return m_stop; });
+
+            std::vector<live_change_t> changes;
+            changes.swap(m_pending);
+            m_position.clear();
+            lock.unlock();
+
+            const size_t count = changes.size();
+            m_send(std::move(changes));
+            ++m_frames;
+            m_changes += count;
+            lock.lock();
+        }
+    }
+};
+
+// Hvad der sker, når en abonnents kø er fuld
+enum class ws_overflow_policy_t
+{
+    drop_oldest, // Den ældste ventende besked smides væk
+    coalesce,    // Alle ventende beskeder erstattes af den nyeste
+    disconnect   // Forbindelsen lukkes
+};
+
+// Tællere for langsomme abonnenter, vist på /metrics
+struct ws_metrics_t
+{
+    std::atomic<uint64_t> m_sent{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_coalesced{0};
+    std::atomic<uint64_t> m_disconnected{0};
+    std::atomic<uint64_t> m_resyncs{0};          // Besvaret fra ændringsloggen
+    std::atomic<uint64_t> m_resyncs_required{0}; // Klienten måtte hente alt
+};
+
+// Socket'en bag en live_subscriber_t. send kaldes først igen, når written
+// er kaldt (med false hvis skrivningen fejlede); kill lukker forbindelsen
+// uden lukke-ramme. Serveren bruger en WebSocket (ws_live_socket_t i
+// main.cpp).
+class live_socket_t
+{
+public:
+    using written_t = std::function<void(bool ok)>;
+
+    virtual ~live_socket_t() = default;
+
+    virtual void send(std::shared_ptr<const std::string> message, bool binary, written_t written) = 0;
+    virtual void kill() = 0;
+};
+
+// En forbindelse til /weather/live med sin egen begrænsede kø. Der er
+// højst én besked undervejs til socket'en ad gangen; resten venter i køen,
+// så en gået i stå browserfane kun kan holde på queue_limit beskeder.
+// Beskederne er delte, uforanderlige buffere, så køen koster kun pegepinde.
+class live_subscriber_t : public std::enable_shared_from_this<live_subscriber_t>
+{
+public:
+    live_subscriber_t(
+        std::shared_ptr<live_socket_t> socket,
+        size_t queue_limit,
+        ws_overflow_policy_t policy,
+        std::shared_ptr<ws_metrics_t> metrics,
+        bool columns = false)
+        : m_socket(std::move(socket))
+        , m_queue_limit(std::max<size_t>(1, queue_limit))
+        , m_policy(policy)
+        , m_metrics(std::move(metrics))
+        , m_columns(columns)
+    {}
+
+    // Om ændringer sendes i kolonneformatet (binære rammer) i stedet for JSON
+    bool columns() const { return m_columns; }
+
+    // Sender eller sætter message i kø. Giver false, hvis forbindelsen
+    // er (eller nu bliver) lukket og bør fjernes fra registret. binary
+    // sender en binær ramme i stedet for en tekstramme.
+    bool send(std::shared_ptr<const std::string> message, bool binary = false)
+    {
+        std::unique_lock lock{m_lock};
+        if (m_closed) {
+            return false;
+        }
+        if (!m_in_flight) {
+            m_in_flight = true;
+            lock.unlock();
+            write({std::move(message), binary});
+            return true;
+        }
+        if (m_queue.size() < m_queue_limit) {
+            m_queue.push_back({std::move(message), binary});
+            return true;
+        }
+
+        switch (m_policy) {
+        case ws_overflow_policy_t::drop_oldest:
+            m_queue.pop_front();
+            m_queue.push_back({std::move(message), binary});
+            ++m_metrics->m_dropped;
+            m_lagged = true;
+            return true;
+        case ws_overflow_policy_t::coalesce:
+            m_metrics->m_coalesced += m_queue.size();
+            m_queue.clear();
+            m_queue.push_back({std::move(message), binary});
+            m_lagged = true;
+            return true;
+        case ws_overflow_policy_t::disconnect:
+            break;
+        }
+        m_closed = true;
+        m_queue.clear();
+        lock.unlock();
+        ++m_metrics->m_disconnected;
+        m_socket->kill(); // En lukke-ramme ville bare stå i samme kø
+        return false;
+    }
+
+private:
+    using message_t = std::pair<std::shared_ptr<const std::string>, bool>; // Besked, binær
+
+    const std::shared_ptr<live_socket_t> m_socket;
+    const size_t m_queue_limit;
+    const ws_overflow_policy_t m_policy;
+    const std::shared_ptr<ws_metrics_t> m_metrics; // Kan overleve handleren ved nedlukning
+    const bool m_columns;
+
+    std::mutex m_lock; // Beskytter alt herunder
+    std::deque<message_t> m_queue;
+    bool m_in_flight = false;
+    bool m_closed = false;
+    bool m_lagged = false; // Der er smidt beskeder væk siden sidste "lagged"
+
+    void write(message_t message)
+    {
+        m_socket->send(std::move(message.first), message.second,
+            [self = shared_from_this()](bool ok) { self->on_written(ok); });
+    }
+
+    void on_written(bool ok)
+    {
+        std::unique_lock lock{m_lock};
+        if (ok) {
+            ++m_metrics->m_sent;
+        } else {
+            m_closed = true;
+            m_queue.clear();
+        }
+        if (m_closed || (m_queue.empty() && !m_lagged)) {
+            m_in_flight = false;
+            return;
+        }
+        message_t next;
+        if (m_lagged) {
+            // Klienten har mistet ændringer og bør bede om en resync
+            static const auto lagged = std::make_shared<const std::string>(R"({"type": "lagged"})");
+            next = {lagged, false};
+            m_lagged = false;
+        } else {
+            next = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        lock.unlock();
+        write(std::move(next));
+    }
+};
+
+// Et rektangel af breddegrader og længdegrader, grænserne medregnet
+struct ws_region_t
+{
+    double m_min_lat = 0;
+    double m_min_lon = 0;
+    double m_max_lat = 0;
+    double m_max_lon = 0;
+
+    bool contains(const place_t& place) const
+    {
+        return place.m_lat >= m_min_lat && place.m_lat <= m_max_lat &&
+               place.m_lon >= m_min_lon && place.m_lon <= m_max_lon;
+    }
+
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        io & json_dto::mandatory("min_lat", m_min_lat)
+           & json_dto::mandatory("min_lon", m_min_lon)
+           & json_dto::mandatory("max_lat", m_max_lat)
+           & json_dto::mandatory("max_lon", m_max_lon);
+    }
+};
+
+// Besked fra en abonnent på /weather/live, fx
+//   {"type": "subscribe", "places": ["Aarhus", "Skagen"]}
+//   {"type": "subscribe", "bbox": {"min_lat": 55, "min_lon": 8, "max_lat": 57, "max_lon": 11}}
+// Med både places og bbox fås ændringer der matcher et af dem; uden
+// nogen af dem fås alt igen. Svaret er samme besked med type "subscribed".
+struct ws_subscribe_message_t
+{
+    std::string m_type;
+    std::optional<std::vector<std::string>> m_places;
+    std::optional<ws_region_t> m_bbox;
+
+    bool everything() const { return (!m_places || m_places->empty()) && !m_bbox; }
+
+    bool matches(const place_t& place) const
+    {
+        return everything() ||
+               (m_places && std::find(m_places->begin(), m_places->end(), place.m_name) != m_places->end()) ||
+               (m_bbox && m_bbox->contains(place));
+    }
+
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        io & json_dto::mandatory("type", m_type)
+           & json_dto::optional_no_default("places", m_places)
+           & json_dto::optional_no_default("bbox", m_bbox);
+    }
+};
+
+// Forbindelser til /weather/live efter forbindelses-ID, med et indeks
+// over hvem der abonnerer på hvad. En til- eller afmelding ændrer kun
+// forbindelsens egne pladser i indekset, så den koster O(log n) og ikke
+// en gennemgang af alle forbindelser; en udsendelse slår kun de steder og
+// områder op, der er ændret. Ikke trådsikkert i sig selv (se
+// weather_handler_t::m_registry).
+class ws_registry_t
+{
+public:
+    struct entry_t
+    {
+        std::shared_ptr<live_subscriber_t> m_subscriber;
+        ws_subscribe_message_t m_subscription; // Tom betyder alt
+    };
+
+    // Forbindelser, der skal have de samme ændringer; indekserne peger ind
+    // i changes i stigende orden
+    struct route_t
+    {
+        std::vector<size_t> m_indices;
+        std::vector<std::pair<uint64_t, std::shared_ptr<live_subscriber_t>>> m_subscribers;
+    };
+
+    void add(uint64_t id, std::shared_ptr<live_subscriber_t> subscriber)
+    {
+        erase(id);
+        const auto& entry = m_entries[id] = entry_t{std::move(subscriber), {}};
+        index(id, entry.m_subscription);
+    }
+
+    // Giver false, hvis forbindelsen ikke (længere) er tilmeldt
+    bool subscribe(uint64_t id, ws_subscribe_message_t subscription)
+    {
+        const auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            return false;
+        }
+        unindex(id, it->second.m_subscription);
+        it->second.m_subscription = std::move(subscription);
+        index(id, it->second.m_subscription);
+        return true;
+    }
+
+    void erase(uint64_t id)
+    {
+        const auto it = m_entries.find(id);
+        if (it != m_entries.end()) {
+            unindex(id, it->second.m_subscription);
+            m_entries.erase(it);
+        }
+    }
+
+    size_t size() const { return m_entries.size(); }
+    size_t filtered() const { return m_entries.size() - m_everything.size(); }
+
+    const entry_t* find(uint64_t id) const
+    {
+        const auto it = m_entries.find(id);
+        return it == m_entries.end() ? nullptr : &it->second;
+    }
+
+    // Forbindelserne der skal have mindst én af changes, samlet efter
+    // hvilke de skal have. Forbindelser uden filter får alle.
+    std::vector<route_t> route(const std::vector<live_change_t>& changes) const
+    {
+        std::map<uint64_t, std::vector<size_t>> matches;
+        auto match = [&](uint64_t id, size_t index) {
+            auto& indices = matches[id];
+            if (indices.empty() || indices.back() != index) {
+                indices.push_back(index); // Et sted kan både stå i places og i bbox
+            }
+        };
+        for (size_t i = 0; i < changes.size(); ++i) {
+            if (const auto it = m_by_place.find(changes[i].m_record.m_place.m_name); it != m_by_place.end()) {
+                for (const uint64_t id : it->second) {
+                    match(id, i);
+                }
+            }
+            for (const auto& [id, region] : m_regions) {
+                if (region.contains(changes[i].m_record.m_place)) {
+                    match(id, i);
+                }
+            }
+        }
+
+        std::vector<route_t> routes;
+        if (!m_everything.empty() && !changes.empty()) {
+            auto& every = routes.emplace_back();
+            every.m_indices.resize(changes.size());
+            std::iota(every.m_indices.begin(), every.m_indices.end(), 0);
+            for (const uint64_t id : m_everything) {
+                every.m_subscribers.emplace_back(id, m_entries.at(id).m_subscriber);
+            }
+        }
+        std::map<std::vector<size_t>, size_t> by_indices; // Udvalg -> plads i routes
+        for (auto& [id, indices] : matches) {
+            const auto [it, inserted] = by_indices.emplace(std::move(indices), routes.size());
+            if (inserted) {
+                routes.push_back({it->first, {}});
+            }
+            routes[it->second].m_subscribers.emplace_back(id, m_entries.at(id).m_subscriber);
+        }
+        return routes;
+    }
+
+private:
+    std::map<uint64_t, entry_t> m_entries;
+
+    // Indekset, afledt af abonnementerne i m_entries
+    std::set<uint64_t> m_everything;                                // Uden filter
+    std::unordered_map<std::string, std::set<uint64_t>> m_by_place; // Stednavn -> forbindelser
+    std::map<uint64_t, ws_region_t> m_regions;                      // Forbindelse -> område
+
+    void index(uint64_t id, const ws_subscribe_message_t& subscription)
+    {
+        if (subscription.everything()) {
+            m_everything.insert(id);
+            return;
+        }
+        if (subscription.m_places) {
+            for (const auto& name : *subscription.m_places) {
+                m_by_place[name].insert(id); // Samme navn to gange i listen giver én
+            }
+        }
+        if (subscription.m_bbox) {
+            m_regions.emplace(id, *subscription.m_bbox);
+        }
+    }
+
+    void unindex(uint64_t id, const ws_subscribe_message_t& subscription)
+    {
+        if (subscription.everything()) {
+            m_everything.erase(id);
+            return;
+        }
+        if (subscription.m_places) {
+            for (const auto& name : *subscription.m_places) {
+                const auto it = m_by_place.find(name);
+                if (it != m_by_place.end()) {
+                    it->second.erase(id);
+                    if (it->second.empty()) {
+                        m_by_place.erase(it);
+                    }
+                }
+            }
+        }
+        m_regions.erase(id);
+    }
+};
+
+// Delta-rammen for de udvalgte ændringer, hvor seq er det højeste
+// løbenummer rammen dækker:
+//   {"type": "weather_delta", "seq": 1234, "created": [...], "updated": [...]}
+// Et svar på en resync har desuden "resync": true efter seq.
+inline std::shared_ptr<const std::string> delta_frame(
+    const std::vector<live_change_t>& changes, const std::vector<size_t>& indices, uint64_t seq, bool resync = false)
+{
+    size_t size = 64;
+    for (const size_t i : indices) {
+        size += changes[i].m_json->size() + 1;
+    }
+    std::string frame;
+    frame.reserve(size);
+
+    auto append = [&](bool created) {
+        bool first = true;
+        for (const size_t i : indices) {
+            if (changes[i].m_created == created) {
+                if (!first) {
+                    frame += ',';
+                }
+                frame += *changes[i].m_json;
+                first = false;
+            }
+        }
+    };
+    frame += R"({"type": "weather_delta", "seq": )" + std::to_string(seq);
+    if (resync) {
+        frame += R"(, "resync": true)";
+    }
+    frame += R"(, "created": [)";
+    append(true);
+    frame += R"(], "updated": [)";
+    append(false);
+    frame += "]}";
+    return std::make_shared<const std::string>(std::move(frame));
+}
+
+// Som delta_frame, men i kolonneformatet (se weather_columns.hpp)
+inline std::shared_ptr<const std::string> columns_delta_frame(
+    const std::vector<live_change_t>& changes, const std::vector<size_t>& indices, uint64_t seq, bool resync = false)
+{
+    weather_columns_writer_t writer{indices.size()};
+    for (const size_t i : indices) {
+        writer.add(changes[i].m_record, changes[i].m_created);
+    }
+    return std::make_shared<const std::string>(writer.frame(
+        resync ? weather_columns_kind_t::resync : weather_columns_kind_t::delta, seq));
+}
+
+// Rammen til en abonnent på /weather/live med de udvalgte changes, i
+// kolonneformatet eller som JSON. seq er det højeste løbenummer, rammen
+// dækker; live_batcher_t beholder en posts første plads, så det er ikke
+// nødvendigvis det sidste.
+inline std::shared_ptr<const std::string> live_delta_frame(
+    const std::vector<live_change_t>& changes, const std::vector<size_t>& indices, bool columns)
+{
+    uint64_t seq = 0;
+    for (const size_t i : indices) {
+        seq = std::max(seq, changes[i].m_seq);
+    }
+    return columns ? columns_delta_frame(changes, indices, seq) : delta_frame(changes, indices, seq);
+}
+
+// Sender changes til forbindelserne i routes (se ws_registry_t::route).
+// frame_for(changes, indekser, kolonner) bygger beskeden til en
+// forbindelse; forbindelser med samme udvalg og format deler den samme
+// uforanderlige buffer, så kun rammens få header-bytes laves pr.
+// forbindelse. Giver ID'erne på forbindelser, der er lukket og skal
+// fjernes fra registret. Kaldes uden registrets lås, da en forbindelse kan
+// lukke (og afmelde sig) under send.
+template <typename F>
+std::vector<uint64_t> send_routes(
+    const std::vector<ws_registry_t::route_t>& routes, const std::vector<live_change_t>& changes, F&& frame_for)
+{
+    std::vector<uint64_t> closed;
+    for (const auto& route : routes) {
+        std::shared_ptr<const std::string> frames[2]; // JSON og kolonner
+        for (const auto& [id, subscriber] : route.m_subscribers) {
+            const bool columns = subscriber->columns();
+            auto& frame = frames[columns];
+            if (!frame) {
+                frame = frame_for(changes, route.m_indices, columns);
+            }
+            if (!subscriber->send(frame, columns)) {
+                closed.push_back(id);
+            }
+        }
+    }
+    return closed;
+}
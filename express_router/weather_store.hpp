@@ -0,0 +1,1486 @@
+#pragma once
+
+// Datamodellen og lageret for vejrdata. Deles af serveren (main.cpp) og
+// indlæseren (loader.cpp), som skriver snapshot-filer serveren kan mmap'e.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <json_dto/pub.hpp>
+#include <charconv>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <type_traits>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Definition af strukturen for Sted (Place)
+struct place_t
+{
+    std::string m_name; // Navn
+    double m_lat;  // Lat
+    double m_lon;  // Lon
+
+    place_t() = default;
+
+    place_t(std::string name, double lat, double lon)
+        : m_name{std::move(name)}, m_lat{lat}, m_lon{lon}
+    {}
+
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        io & json_dto::mandatory("Navn", m_name)
+           & json_dto::mandatory("Lat", m_lat)
+           & json_dto::mandatory("Lon", m_lon);
+    }
+};
+
+// Definition af strukturen for Dato og Tid (DateTime)
+// Internt et enkelt tal: minutter siden 1970-01-01 00:00. Dato og
+// klokkeslæt som tekst ("2024.04.15", "10:15") findes kun i JSON.
+struct dateTime_t
+{
+    static constexpr int64_t minutes_per_day = 24 * 60;
+
+    int64_t m_minutes = 0; // Minutter siden epoch
+
+    dateTime_t() = default;
+
+    explicit dateTime_t(int64_t minutes)
+        : m_minutes{minutes}
+    {}
+
+    dateTime_t(std::string_view date, std::string_view time)
+        : m_minutes{parse_date(date) * minutes_per_day + parse_time(time)}
+    {}
+
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        if constexpr (std::is_same_v<JSON_IO, json_dto::json_input_t>) {
+            std::string date;
+            std::string time;
+            io & json_dto::mandatory("Dato", date)
+               & json_dto::mandatory("Klokkeslæt", time);
+            *this = dateTime_t{date, time};
+        } else {
+            std::string date = date_string();
+            std::string time = time_string();
+            io & json_dto::mandatory("Dato", date)
+               & json_dto::mandatory("Klokkeslæt", time);
+        }
+    }
+
+    // Dagnummer siden epoch (rundet ned, også før 1970)
+    int64_t day() const {
+        return floor_div(m_minutes, minutes_per_day);
+    }
+
+    int minute_of_day() const {
+        return static_cast<int>(m_minutes - day() * minutes_per_day);
+    }
+
+    // År, måned og dag
+    void date_parts(int64_t &y, unsigned &m, unsigned &d) const {
+        civil_from_days(day(), y, m, d);
+    }
+
+    // "2024.04.15"
+    std::string date_string() const {
+        int64_t y;
+        unsigned m, d;
+        date_parts(y, m, d);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%04lld.%02u.%02u", static_cast<long long>(y), m, d);
+        return buf;
+    }
+
+    // "10:15"
+    std::string time_string() const {
+        const int minutes = minute_of_day();
+        char buf[8];
+        snprintf(buf, sizeof(buf), "%02d:%02d", minutes / 60, minutes % 60);
+        return buf;
+    }
+
+    // Dagnummer for en dato. Accepterer "2024.04.15", "2024-04-15" og
+    // "20240415". Kaster invalid_argument ved ugyldig dato.
+    static int64_t parse_date(std::string_view date) {
+        const auto day = try_parse_date(date);
+        if (!day) {
+            throw std::invalid_argument("Ugyldig dato: " + std::string(date));
+        }
+        return *day;
+    }
+
+    static std::optional<int64_t> try_parse_date(std::string_view date) {
+        unsigned y = 0, m = 0, d = 0;
+        if (date.size() == 8) {
+            if (!parse_digits(date.substr(0, 4), y) ||
+                !parse_digits(date.substr(4, 2), m) ||
+                !parse_digits(date.substr(6, 2), d)) {
+                return std::nullopt;
+            }
+        } else if (date.size() == 10 && date[4] == date[7] &&
+                   (date[4] == '.' || date[4] == '-')) {
+            if (!parse_digits(date.substr(0, 4), y) ||
+                !parse_digits(date.substr(5, 2), m) ||
+                !parse_digits(date.substr(8, 2), d)) {
+                return std::nullopt;
+            }
+        } else {
+            return std::nullopt;
+        }
+
+        if (m < 1 || m > 12 || d < 1 || d > days_in_month(y, m)) {
+            return std::nullopt;
+        }
+        return days_from_civil(y, m, d);
+    }
+
+    // Minutter efter midnat for "HH:MM" (timen må være et ciffer)
+    static int parse_time(std::string_view time) {
+        const auto colon = time.find(':');
+        unsigned h = 0, m = 0;
+        if (colon == std::string_view::npos || colon == 0 || colon > 2 ||
+            time.size() - colon - 1 != 2 ||
+            !parse_digits(time.substr(0, colon), h) ||
+            !parse_digits(time.substr(colon + 1), m) ||
+            h > 23 || m > 59) {
+            throw std::invalid_argument("Ugyldigt klokkeslæt: " + std::string(time));
+        }
+        return static_cast<int>(h * 60 + m);
+    }
+
+    bool operator<(const dateTime_t& other) const {
+        return m_minutes < other.m_minutes;
+    }
+    bool operator==(const dateTime_t& other) const {
+        return m_minutes == other.m_minutes;
+    }
+
+private:
+    static int64_t floor_div(int64_t a, int64_t b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+
+    static bool parse_digits(std::string_view text, unsigned &value) {
+        const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc{} && ptr == text.data() + text.size();
+    }
+
+    static unsigned days_in_month(unsigned y, unsigned m) {
+        static constexpr unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        const bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        return m == 2 && leap ? 29 : days[m - 1];
+    }
+
+    // Kalenderomregning efter H. Hinnants "days_from_civil"/"civil_from_days"
+    static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    static void civil_from_days(int64_t z, int64_t &y, unsigned &m, unsigned &d) {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+    }
+};
+
+// Definition af strukturen for Vejrudsigt (Weathercast data)
+struct weathercast_t
+{
+    std::string m_id;
+    dateTime_t m_dateTime;   // Dato og tid
+    place_t m_place;         // Sted
+    double m_temperature;    // Temperatur
+    int m_humidity;          // Luftfugtighed
+
+    weathercast_t() = default;
+
+    weathercast_t(
+        std::string id,
+        dateTime_t dateTime,
+        place_t place,
+        double temperature,
+        int humidity)
+        : m_id{std::move(id)},
+          m_dateTime{std::move(dateTime)},
+          m_place{std::move(place)},
+          m_temperature{temperature},
+          m_humidity{humidity}
+    {}
+
+    template <typename JSON_IO>
+    void json_io(JSON_IO &io)
+    {
+        io & json_dto::optional("ID", m_id, "")
+           & json_dto::mandatory("Tidspunkt (dato og klokkeslæt)", m_dateTime)
+           & json_dto::mandatory("Sted", m_place)
+           & json_dto::mandatory("Temperatur", m_temperature)
+           & json_dto::mandatory("Luftfugtighed", m_humidity);
+    }
+};
+
+// Om p er den eneste reference til det, den peger på, så det kan ændres
+// på stedet. Hegnet sikrer, at en anden tråd, der netop har sluppet sin
+// reference, også er færdig med at læse, før der skrives.
+template <typename T>
+bool unshared(const std::shared_ptr<T>& p)
+{
+    if (p.use_count() != 1) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+// Vektor opdelt i delte blade (copy-on-write). En kopi af vektoren deler
+// alle blade med originalen; en ændring kopierer kun det berørte blad og
+// dets gren, og kun hvis de stadig deles. Roden har én gren pr. 64K
+// elementer, så en kopi eller skrivning koster næsten det samme uanset
+// længden, og gentagne skrivninger i samme kopi ændrer på stedet.
+template <typename T>
+class cow_vector_t
+{
+public:
+    static constexpr size_t leaf_bits = 10;
+    static constexpr size_t leaf_size = size_t{1} << leaf_bits;
+    static constexpr size_t branch_bits = 6;
+    static constexpr size_t branch_size = size_t{1} << branch_bits;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const T& operator[](size_t i) const
+    {
+        const branch_t& branch = *m_root[i >> (leaf_bits + branch_bits)];
+        return branch[(i >> leaf_bits) & (branch_size - 1)][i & (leaf_size - 1)];
+    }
+
+    void push_back(const T& value)
+    {
+        *writable(m_size) = value;
+        ++m_size;
+    }
+
+    void set(size_t i, const T& value)
+    {
+        *writable(i) = value;
+    }
+
+    // Giver en skrivbar pegepind til element i og kopierer først bladet
+    // (og grenen over det), hvis det deles med en anden kopi. i må højst
+    // være size().
+    T* writable(size_t i)
+    {
+        const size_t b = i >> (leaf_bits + branch_bits);
+        const size_t l = (i >> leaf_bits) & (branch_size - 1);
+        if (b == m_root.size()) {
+            m_root.push_back(std::make_shared<branch_t>());
+            m_root.back()->reserve(branch_size);
+        } else if (!unshared(m_root[b])) {
+            m_root[b] = std::make_shared<branch_t>(*m_root[b]);
+        }
+        branch_t& branch = *m_root[b];
+        if (l == branch.size()) {
+            branch.emplace_back();
+        }
+
+        leaf_t& leaf = branch[l];
+        const size_t leaf_start = i & ~(leaf_size - 1);
+        if (!leaf || !unshared(leaf)) {
+            std::unique_ptr<T[]> copy{new T[leaf_size]}; // Kun [0, size()) læses
+            if (leaf) {
+                std::copy_n(&leaf[0], std::min(leaf_size, m_size - leaf_start), copy.get());
+            }
+            leaf = leaf_t{std::move(copy)};
+        }
+        // Bladet er allokeret her som ikke-konstant, så det må ændres
+        return const_cast<T*>(leaf.get()) + (i - leaf_start);
+    }
+
+    // Vektor hvis blade peger direkte ind i data, som owner holder i live
+    // (fx en mmap'et fil). Intet kopieres, før der skrives i et blad.
+    static cow_vector_t view(const std::shared_ptr<const void>& owner, const T* data, size_t n)
+    {
+        cow_vector_t result;
+        result.m_view_owner = owner;
+        std::shared_ptr<branch_t> branch;
+        for (size_t start = 0; start < n; start += leaf_size) {
+            if (!branch) {
+                branch = std::make_shared<branch_t>();
+                branch->reserve(branch_size);
+            }
+            branch->push_back(leaf_t{owner, data + start});
+            if (branch->size() == branch_size) {
+                result.m_root.push_back(std::move(branch));
+            }
+        }
+        if (branch) {
+            result.m_root.push_back(std::move(branch));
+        }
+        result.m_size = n;
+        return result;
+    }
+
+    // Kalder f(data, antal) for hvert blad i rækkefølge
+    template <typename F>
+    void for_each_chunk(F&& f) const
+    {
+        size_t start = 0;
+        for (const auto& branch : m_root) {
+            for (const leaf_t& leaf : *branch) {
+                const size_t n = std::min(leaf_size, m_size - start);
+                f(leaf.get(), n);
+                start += n;
+            }
+        }
+    }
+
+private:
+    using leaf_t = std::shared_ptr<const T[]>;
+    using branch_t = std::vector<leaf_t>;
+
+    std::vector<std::shared_ptr<branch_t>> m_root;
+    size_t m_size = 0;
+
+    // Ejer af bladene fra view. Så længe den holdes her, deler de altid
+    // deres optælling med mindst én anden, og unshared ser dem aldrig som
+    // skrivbare (de kan være skrivebeskyttet hukommelse eller kortere end
+    // et helt blad).
+    std::shared_ptr<const void> m_view_owner;
+};
+
+// Sorteret sekvens opdelt i blade på højst max_leaf elementer, samlet i
+// grene på højst max_branch blade, som deles mellem kopier (samme to
+// niveauer som cow_vector_t). En kopi koster kun roden; indsættelse og
+// sletning kopierer ét blad og dets gren, hvis de stadig deles, og ændrer
+// ellers på stedet.
+template <typename Entry>
+class cow_sorted_index_t
+{
+public:
+    static constexpr size_t max_leaf = 2048;
+    static constexpr size_t max_branch = 64;
+
+    size_t size() const { return m_size; }
+
+    // Bygger indekset af n elementer, der allerede er sorteret;
+    // entry_at(i) giver det i'te. Bladene fyldes halvt, så de første
+    // indsættelser ikke straks deler dem.
+    template <typename F>
+    static cow_sorted_index_t from_sorted(size_t n, F&& entry_at)
+    {
+        cow_sorted_index_t result;
+        for (size_t start = 0; start < n; start += max_leaf / 2) {
+            const size_t end = std::min(n, start + max_leaf / 2);
+            auto leaf = std::make_shared<leaf_t>();
+            leaf->reserve(end - start);
+            for (size_t i = start; i < end; ++i) {
+                leaf->push_back(entry_at(i));
+            }
+            if (result.m_root.empty() || result.m_root.back()->size() == max_branch) {
+                result.m_root.push_back(std::make_shared<branch_t>());
+            }
+            result.m_root.back()->push_back(std::move(leaf));
+        }
+        result.m_size = n;
+        return result;
+    }
+
+    // Indsætter efter eventuelle lige store elementer
+    void insert(const Entry& entry)
+    {
+        insert_sorted(&entry, &entry + 1);
+    }
+
+    // Indsætter de sorterede elementer [first, last). Elementer, der skal
+    // i samme blad, flettes ind i én omgang, så en batch af nye elementer
+    // i enden kun rører det sidste blad.
+    void insert_sorted(const Entry* first, const Entry* last)
+    {
+        if (first == last) {
+            return;
+        }
+        m_size += static_cast<size_t>(last - first);
+        if (m_root.empty()) {
+            m_root.push_back(std::make_shared<branch_t>(1, std::make_shared<leaf_t>(first, last)));
+            split({0, 0});
+            return;
+        }
+        while (first != last) {
+            // Sidste blad hvis første element er <= *first (eller det første blad)
+            const position_t at = find(*first, [](const Entry& e, const Entry& front) { return !(e < front); });
+            const Entry* end = last;
+            if (const Entry* next = front_after(at)) {
+                end = std::lower_bound(first, last, *next, [](const Entry& e, const Entry& n) { return e < n; });
+            }
+
+            leaf_t& leaf = writable(at);
+            const auto middle = static_cast<ptrdiff_t>(leaf.size());
+            leaf.insert(leaf.end(), first, end);
+            std::inplace_merge(leaf.begin(), leaf.begin() + middle, leaf.end()); // Stabil
+            split(at);
+            first = end;
+        }
+    }
+
+    bool erase(const Entry& entry)
+    {
+        for (position_t at = first_leaf(entry); at.m_branch < m_root.size(); at = next(at)) {
+            const leaf_t& current = leaf_at(at);
+            const auto pos = std::lower_bound(current.begin(), current.end(), entry);
+            if (pos == current.end()) {
+                continue;
+            }
+            if (entry < *pos) {
+                return false;
+            }
+
+            const auto offset = pos - current.begin();
+            leaf_t& leaf = writable(at);
+            leaf.erase(leaf.begin() + offset);
+            if (leaf.empty()) {
+                branch_t& branch = *m_root[at.m_branch];
+                branch.erase(branch.begin() + static_cast<ptrdiff_t>(at.m_leaf));
+                if (branch.empty()) {
+                    m_root.erase(m_root.begin() + static_cast<ptrdiff_t>(at.m_branch));
+                }
+            }
+            --m_size;
+            return true;
+        }
+        return false;
+    }
+
+    // Første element >= entry, O(log n)
+    std::optional<Entry> first_not_less(const Entry& entry) const
+    {
+        for (position_t at = first_leaf(entry); at.m_branch < m_root.size(); at = next(at)) {
+            const leaf_t& leaf = leaf_at(at);
+            const auto pos = std::lower_bound(leaf.begin(), leaf.end(), entry);
+            if (pos != leaf.end()) {
+                return *pos;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Kalder f for hvert element i [from, to) i sorteret rækkefølge
+    template <typename F>
+    void for_each(const Entry& from, const Entry& to, F&& f) const
+    {
+        for (position_t at = first_leaf(from); at.m_branch < m_root.size(); at = next(at)) {
+            const leaf_t& leaf = leaf_at(at);
+            for (auto it = std::lower_bound(leaf.begin(), leaf.end(), from); it != leaf.end(); ++it) {
+                if (!(*it < to)) {
+                    return;
+                }
+                f(*it);
+            }
+        }
+    }
+
+    // Kalder f for alle elementer i sorteret rækkefølge
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (const auto& branch : m_root) {
+            for (const auto& leaf : *branch) {
+                for (const Entry& entry : *leaf) {
+                    f(entry);
+                }
+            }
+        }
+    }
+
+private:
+    using leaf_t = std::vector<Entry>;
+    using branch_t = std::vector<std::shared_ptr<leaf_t>>;
+
+    struct position_t
+    {
+        size_t m_branch;
+        size_t m_leaf;
+    };
+
+    std::vector<std::shared_ptr<branch_t>> m_root; // Ingen tomme grene eller blade
+    size_t m_size = 0;
+
+    const leaf_t& leaf_at(position_t at) const { return *(*m_root[at.m_branch])[at.m_leaf]; }
+
+    position_t next(position_t at) const
+    {
+        if (++at.m_leaf == m_root[at.m_branch]->size()) {
+            return {at.m_branch + 1, 0};
+        }
+        return at;
+    }
+
+    // Sidste blad hvis første element opfylder before(entry, første),
+    // eller det første blad. Søger binært først i grenene, så i bladene.
+    template <typename BEFORE>
+    position_t find(const Entry& entry, BEFORE before) const
+    {
+        if (m_root.empty()) {
+            return {0, 0};
+        }
+        auto branch = std::upper_bound(m_root.begin(), m_root.end(), entry,
+            [&](const Entry& e, const std::shared_ptr<branch_t>& b) { return !before(e, b->front()->front()); });
+        const size_t bi = branch == m_root.begin() ? 0 : static_cast<size_t>(branch - m_root.begin()) - 1;
+        const branch_t& leaves = *m_root[bi];
+        auto leaf = std::upper_bound(leaves.begin(), leaves.end(), entry,
+            [&](const Entry& e, const std::shared_ptr<leaf_t>& l) { return !before(e, l->front()); });
+        return {bi, leaf == leaves.begin() ? 0 : static_cast<size_t>(leaf - leaves.begin()) - 1};
+    }
+
+    // Første blad der kan indeholde elementer >= entry
+    position_t first_leaf(const Entry& entry) const
+    {
+        return find(entry, [](const Entry& e, const Entry& front) { return front < e; });
+    }
+
+    // Første element i bladet efter at, eller nullptr hvis det er det sidste
+    const Entry* front_after(position_t at) const
+    {
+        const position_t following = next(at);
+        return following.m_branch < m_root.size() ? &leaf_at(following).front() : nullptr;
+    }
+
+    // Bladet ved at, kopieret (med sin gren) hvis det deles
+    leaf_t& writable(position_t at)
+    {
+        auto& branch = m_root[at.m_branch];
+        if (!unshared(branch)) {
+            branch = std::make_shared<branch_t>(*branch);
+        }
+        auto& leaf = (*branch)[at.m_leaf];
+        if (!unshared(leaf)) {
+            leaf = std::make_shared<leaf_t>(*leaf);
+        }
+        return *leaf;
+    }
+
+    // Deler bladet ved at (og dets gren), hvis det er blevet for stort.
+    // Bladet er allerede skrivbart.
+    void split(position_t at)
+    {
+        branch_t& branch = *m_root[at.m_branch];
+        leaf_t& leaf = *branch[at.m_leaf];
+        if (leaf.size() > max_leaf) {
+            std::vector<std::shared_ptr<leaf_t>> pieces;
+            for (size_t start = max_leaf / 2; start < leaf.size(); start += max_leaf / 2) {
+                const auto from = leaf.begin() + static_cast<ptrdiff_t>(start);
+                const auto to = leaf.begin() + static_cast<ptrdiff_t>(std::min(leaf.size(), start + max_leaf / 2));
+                pieces.push_back(std::make_shared<leaf_t>(from, to));
+            }
+            leaf.resize(max_leaf / 2);
+            branch.insert(branch.begin() + static_cast<ptrdiff_t>(at.m_leaf) + 1, pieces.begin(), pieces.end());
+        }
+        if (branch.size() > max_branch) {
+            std::vector<std::shared_ptr<branch_t>> pieces;
+            for (size_t start = max_branch / 2; start < branch.size(); start += max_branch / 2) {
+                const auto from = branch.begin() + static_cast<ptrdiff_t>(start);
+                const auto to = branch.begin() + static_cast<ptrdiff_t>(std::min(branch.size(), start + max_branch / 2));
+                pieces.push_back(std::make_shared<branch_t>(from, to));
+            }
+            branch.resize(max_branch / 2);
+            m_root.insert(m_root.begin() + static_cast<ptrdiff_t>(at.m_branch) + 1, pieces.begin(), pieces.end());
+        }
+    }
+};
+
+// Ordbog over steder. Hvert særskilt sted (navn, lat, lon) gemmes én gang
+// og får et 32-bit ID, som posterne i lageret henviser til.
+class place_dictionary_t
+{
+public:
+    using place_id_t = uint32_t;
+
+    std::optional<place_id_t> find(const place_t& place) const
+    {
+        const auto it = m_by_name.find(place.m_name);
+        if (it != m_by_name.end()) {
+            for (const place_id_t id : it->second) {
+                const place_t& known = m_places[id];
+                if (known.m_lat == place.m_lat && known.m_lon == place.m_lon) {
+                    return id;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Giver ID'et for stedet og opretter det, hvis det er nyt
+    place_id_t intern(const place_t& place)
+    {
+        if (const auto known = find(place)) {
+            return *known;
+        }
+        const auto id = static_cast<place_id_t>(m_places.size());
+        m_places.push_back(place);
+        m_by_name[place.m_name].push_back(id);
+        return id;
+    }
+
+    const place_t& operator[](place_id_t id) const { return m_places[id]; }
+    size_t size() const { return m_places.size(); }
+
+    // Alle steds-ID'er med dette navn (samme navn kan have flere koordinater)
+    std::vector<place_id_t> find_by_name(const std::string& name) const
+    {
+        const auto it = m_by_name.find(name);
+        if (it == m_by_name.end()) {
+            return {};
+        }
+        return it->second;
+    }
+
+private:
+    std::vector<place_t> m_places;
+    std::unordered_map<std::string, std::vector<place_id_t>> m_by_name;
+};
+
+// fsync'er mappen som path ligger i, så en omdøbning til path er på
+// disken og ikke kan gå tabt ved et nedbrud
+inline void sync_parent_directory(const std::string& path)
+{
+    const auto slash = path.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Kan ikke åbne mappen " + directory + ": " + strerror(errno));
+    }
+    const int result = ::fsync(fd);
+    const int error = errno;
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Kan ikke synkronisere mappen " + directory + ": " + strerror(error));
+    }
+}
+
+// Lager for vejrdata, organiseret kolonnevis (struct-of-arrays): hver
+// egenskab ligger i sin egen kolonne, så gennemløb af fx temperatur eller
+// tidspunkt kun rører de bytes der faktisk bruges. En post er en plads
+// (slot) på tværs af kolonnerne i indsættelsesrækkefølge. Steder er
+// internaliseret i en place_dictionary_t, så en post kun bærer et 32-bit
+// steds-ID.
+//
+// Et primærnøgle-indeks (numerisk ID -> plads) gør opslag og opdateringer
+// på ID konstant tid. Et sekundært tidsindeks (tidspunkt, plads) holdes
+// sorteret, så datoforespørgsler bliver en binær søgning og et udsnit.
+// Et stedsindeks (steds-ID -> pladser) besvarer forespørgsler pr. sted.
+//
+// Alle kolonner og indeks er copy-on-write, så en kopi af lageret er billig
+// og deler data med originalen. Det bruger shared_weather_store_t til at
+// udgive uforanderlige versioner til læserne. Blade og grene, som kun én
+// kopi har, ændres på stedet, så flere skrivninger i samme kopi (en batch
+// eller afspilning af loggen) kun kopierer første gang.
+class weather_store_t
+{
+public:
+    using slot_t = size_t;
+    using place_id_t = place_dictionary_t::place_id_t;
+
+    // Største hul i ID-rækken. ID-indekset er en tabel opslået direkte på
+    // ID, så ID'er skal tildeles nogenlunde fortløbende.
+    static constexpr uint64_t max_id_gap = uint64_t{1} << 20;
+
+    // Fortolker et ID ("17") som tal. Tomt resultat hvis ID'et ikke er numerisk.
+    static std::optional<uint64_t> parse_id(std::string_view id)
+    {
+        uint64_t value = 0;
+        const auto [ptr, ec] = std::from_chars(id.data(), id.data() + id.size(), value);
+        if (ec != std::errc{} || ptr != id.data() + id.size() || id.empty()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    size_t size() const { return m_ids.size(); }
+    bool empty() const { return m_ids.empty(); }
+
+    // Tælles op for hver post der oprettes eller ændres
+    uint64_t version() const { return m_version; }
+
+    // Samler en post fra kolonnerne
+    weathercast_t record(slot_t slot) const
+    {
+        return weathercast_t{
+            std::to_string(m_ids[slot]),
+            dateTime_t{m_timestamps[slot]},
+            (*m_places)[m_place_ids[slot]],
+            m_temperatures[slot],
+            m_humidities[slot]};
+    }
+
+    // Pladsen for et ID, fx som udgangspunkt for en side (cursor)
+    std::optional<slot_t> slot_of(uint64_t id) const
+    {
+        if (id == 0 || id > m_id_index.size() || m_id_index[id - 1] == no_slot) {
+            return std::nullopt;
+        }
+        return m_id_index[id - 1];
+    }
+
+    uint64_t id_at(slot_t slot) const { return m_ids[slot]; }
+
+    std::optional<weathercast_t> find_by_id(uint64_t id) const
+    {
+        const auto slot = slot_of(id);
+        if (!slot) {
+            return std::nullopt;
+        }
+        return record(*slot);
+    }
+
+    // Findes der allerede en post med dette tidspunkt?
+    // Slås op i tidsindekset, så prisen ikke vokser med antallet af poster.
+    bool contains_time(const dateTime_t& when) const
+    {
+        const auto first = m_time_index.first_not_less({when.m_minutes, 0});
+        return first && first->first == when.m_minutes;
+    }
+
+    // Indsætter en post. Har posten intet ID, tildeles det næste ledige.
+    weathercast_t insert(weathercast_t record)
+    {
+        const slot_t slot = append(record);
+        m_time_index.insert({record.m_dateTime.m_minutes, slot});
+        index_place(m_place_ids[slot], slot);
+        return record;
+    }
+
+    // Indsætter mange poster med samme regler som insert. Kolonnerne
+    // udvides post for post, men tids- og stedsindeksene flettes kun én
+    // gang for hele batchen. Returnerer posterne med deres ID'er. Kaster
+    // som insert; posterne før den afviste er så indsat.
+    std::vector<weathercast_t> insert_batch(std::vector<weathercast_t> records)
+    {
+        std::vector<time_entry_t> times;
+        std::vector<std::pair<place_id_t, slot_t>> places;
+        times.reserve(records.size());
+        places.reserve(records.size());
+
+        auto index = [&] {
+            std::sort(times.begin(), times.end());
+            m_time_index.insert_sorted(times.data(), times.data() + times.size());
+
+            std::sort(places.begin(), places.end());
+            std::vector<slot_t> slots;
+            for (size_t i = 0; i < places.size();) {
+                const place_id_t place_id = places[i].first;
+                slots.clear();
+                for (; i < places.size() && places[i].first == place_id; ++i) {
+                    slots.push_back(places[i].second);
+                }
+                writable_place_slots(place_id).insert_sorted(slots.data(), slots.data() + slots.size());
+            }
+        };
+
+        try {
+            for (auto& record : records) {
+                const slot_t slot = append(record);
+                times.emplace_back(record.m_dateTime.m_minutes, slot);
+                places.emplace_back(m_place_ids[slot], slot);
+            }
+        } catch (...) {
+            index();
+            throw;
+        }
+        index();
+        return records;
+    }
+
+    // Opdaterer alt undtagen ID. Tomt resultat hvis ID ikke findes.
+    std::optional<weathercast_t> update(uint64_t id, const weathercast_t& data)
+    {
+        const auto found = slot_of(id);
+        if (!found) {
+            return std::nullopt;
+        }
+        const slot_t slot = *found;
+
+        const int64_t minutes = data.m_dateTime.m_minutes;
+        if (m_timestamps[slot] != minutes) {
+            m_time_index.erase({m_timestamps[slot], slot});
+            m_time_index.insert({minutes, slot});
+            m_timestamps.set(slot, minutes);
+        }
+
+        const place_id_t place_id = intern_place(data.m_place);
+        if (m_place_ids[slot] != place_id) {
+            unindex_place(m_place_ids[slot], slot);
+            index_place(place_id, slot);
+            m_place_ids.set(slot, place_id);
+        }
+
+        m_temperatures.set(slot, data.m_temperature);
+        m_humidities.set(slot, data.m_humidity);
+        ++m_version;
+        return record(slot);
+    }
+
+    // Alle poster fra dagnummer from til og med dagnummer to, sorteret
+    // efter tidspunkt og derefter indsættelsesrækkefølge.
+    std::vector<weathercast_t> find_by_date_range(int64_t from_day, int64_t to_day) const
+    {
+        std::vector<weathercast_t> result;
+        if (from_day > to_day) {
+            return result;
+        }
+        m_time_index.for_each(
+            time_entry_t{from_day * dateTime_t::minutes_per_day, 0},
+            time_entry_t{(to_day + 1) * dateTime_t::minutes_per_day, 0},
+            [&](const time_entry_t& entry) { result.push_back(record(entry.second)); });
+        return result;
+    }
+
+    // Alle poster for steder med dette navn i indsættelsesrækkefølge
+    std::vector<weathercast_t> find_by_place(const std::string& name) const
+    {
+        std::vector<slot_t> slots;
+        for (const place_id_t place_id : m_places->find_by_name(name)) {
+            if (place_id < m_place_index.size()) {
+                m_place_index[place_id]->for_each([&](slot_t slot) { slots.push_back(slot); });
+            }
+        }
+        std::sort(slots.begin(), slots.end()); // Kun nødvendigt ved flere koordinater
+
+        std::vector<weathercast_t> result;
+        result.reserve(slots.size());
+        for (const slot_t slot : slots) {
+            result.push_back(record(slot));
+        }
+        return result;
+    }
+
+    // Gemmer lageret som snapshot-fil: et fast binært format, som
+    // load_snapshot kan mmap'e og bruge uden at parse noget. log_position
+    // er det LSN i write-ahead-loggen, som snapshottet dækker til og med.
+    // Filen skrives ved siden af og omdøbes, så en halv fil aldrig ses.
+    // Mappen fsync'es efter omdøbningen, så snapshottet er på disken, før
+    // loggen bag det må komprimeres.
+    void save_snapshot(const std::string& path, uint64_t log_position) const
+    {
+        snapshot_header_t header{};
+        memcpy(header.m_magic, snapshot_magic, sizeof header.m_magic);
+        header.m_format = snapshot_format;
+        header.m_records = size();
+        header.m_places = m_places->size();
+        header.m_id_index_size = m_id_index.size();
+        header.m_next_id = m_next_id;
+        header.m_log_position = log_position;
+        header.m_version = m_version;
+        for (size_t place = 0; place < m_places->size(); ++place) {
+            header.m_names_size += (*m_places)[static_cast<place_id_t>(place)].m_name.size();
+        }
+        const snapshot_layout_t layout{header};
+
+        const std::string temp_path = path + ".tmp";
+        FILE* out = fopen(temp_path.c_str(), "wb");
+        if (!out) {
+            throw std::runtime_error("Kan ikke oprette " + temp_path + ": " + strerror(errno));
+        }
+        size_t written = 0;
+        auto write = [&](const void* data, size_t bytes) {
+            if (bytes != 0 && fwrite(data, 1, bytes, out) != bytes) {
+                throw std::runtime_error("Kan ikke skrive " + temp_path + ": " + strerror(errno));
+            }
+            written += bytes;
+        };
+        // Nuller op til starten af næste afsnit
+        auto section = [&](size_t offset) {
+            static const char zeros[8] = {};
+            write(zeros, offset - written);
+        };
+        auto column = [&](size_t offset, const auto& values) {
+            section(offset);
+            values.for_each_chunk([&](const auto* data, size_t n) { write(data, n * sizeof *data); });
+        };
+
+        try {
+            write(&header, sizeof header);
+            column(layout.m_ids, m_ids);
+            column(layout.m_timestamps, m_timestamps);
+            column(layout.m_place_ids, m_place_ids);
+            column(layout.m_temperatures, m_temperatures);
+            column(layout.m_humidities, m_humidities);
+            column(layout.m_id_index, m_id_index);
+
+            section(layout.m_places);
+            uint64_t name_offset = 0;
+            for (size_t place = 0; place < m_places->size(); ++place) {
+                const place_t& known = (*m_places)[static_cast<place_id_t>(place)];
+                const snapshot_place_t entry{known.m_lat, known.m_lon, name_offset, known.m_name.size()};
+                write(&entry, sizeof entry);
+                name_offset += known.m_name.size();
+            }
+
+            section(layout.m_place_counts);
+            for (size_t place = 0; place < m_places->size(); ++place) {
+                const uint64_t count = place < m_place_index.size() ? m_place_index[place]->size() : 0;
+                write(&count, sizeof count);
+            }
+            section(layout.m_place_slots);
+            for (size_t place = 0; place < m_place_index.size(); ++place) {
+                m_place_index[place]->for_each([&](slot_t slot) {
+                    const uint64_t value = slot;
+                    write(&value, sizeof value);
+                });
+            }
+
+            section(layout.m_time_index);
+            m_time_index.for_each([&](const time_entry_t& entry) {
+                const snapshot_time_entry_t value{entry.first, entry.second};
+                write(&value, sizeof value);
+            });
+
+            section(layout.m_names);
+            for (size_t place = 0; place < m_places->size(); ++place) {
+                const std::string& name = (*m_places)[static_cast<place_id_t>(place)].m_name;
+                write(name.data(), name.size());
+            }
+            section(layout.m_end);
+
+            if (fflush(out) != 0 || ::fsync(fileno(out)) != 0) {
+                throw std::runtime_error("Kan ikke skrive " + temp_path + ": " + strerror(errno));
+            }
+        } catch (...) {
+            fclose(out);
+            ::unlink(temp_path.c_str());
+            throw;
+        }
+        fclose(out);
+        if (::rename(temp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Kan ikke omdøbe " + temp_path + ": " + strerror(errno));
+        }
+        sync_parent_directory(path);
+    }
+
+    // Mapper en snapshot-fil ind i hukommelsen. Kolonnerne og ID-indekset
+    // peger direkte ind i filen (copy-on-write), så kun tids- og
+    // stedsindeks kopieres ud. Headeren tjekkes (magic, format og at
+    // afsnittene passer med filens størrelse), og i én gennemgang af
+    // filen alt, hvad der senere bruges som plads eller opslag: sted i
+    // stedtabellen, at ID-indekset og ID-kolonnen peger på hinanden, og at
+    // steds- og tidsindeks er sorteret og passer med kolonnerne. En
+    // ødelagt fil afvises derfor i stedet for at give læsninger uden for
+    // kolonnerne eller forkerte svar.
+    static weather_store_t load_snapshot(const std::string& path, uint64_t& log_position)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Kan ikke åbne " + path + ": " + strerror(errno));
+        }
+        struct stat info{};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Kan ikke læse " + path + ": " + strerror(errno));
+        }
+        const auto file_size = static_cast<size_t>(info.st_size);
+        if (file_size < sizeof(snapshot_header_t)) {
+            ::close(fd);
+            throw std::runtime_error("Ugyldig snapshot-fil: " + path);
+        }
+        void* const mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Kan ikke mappe " + path + ": " + strerror(errno));
+        }
+        const std::shared_ptr<const void> owner{mapping, [file_size](const void* p) {
+            ::munmap(const_cast<void*>(p), file_size);
+        }};
+        const char* const base = static_cast<const char*>(mapping);
+
+        snapshot_header_t header;
+        memcpy(&header, base, sizeof header);
+        if (memcmp(header.m_magic, snapshot_magic, sizeof header.m_magic) != 0) {
+            throw std::runtime_error("Ikke en snapshot-fil: " + path);
+        }
+        if (header.m_format != snapshot_format) {
+            throw std::runtime_error("Snapshot-filen " + path + " har format " + std::to_string(header.m_format) +
+                                     ", men kun format " + std::to_string(snapshot_format) + " kan læses");
+        }
+        const snapshot_layout_t layout{header};
+        if (layout.m_overflow || layout.m_end != file_size) {
+            throw std::runtime_error("Ugyldig snapshot-fil (afsnittene passer ikke med størrelsen): " + path);
+        }
+        auto invalid = [&](const char* what) {
+            return std::runtime_error(std::string("Ugyldig snapshot-fil (") + what + "): " + path);
+        };
+        weather_store_t store;
+        const size_t n = header.m_records;
+        const auto* ids = section_at<uint64_t>(base, layout.m_ids);
+        const auto* timestamps = section_at<int64_t>(base, layout.m_timestamps);
+        const auto* place_ids = section_at<place_id_t>(base, layout.m_place_ids);
+        const auto* id_index = section_at<slot_t>(base, layout.m_id_index);
+
+        // ID-kolonnen og ID-indekset skal pege på hinanden: hver post har et
+        // ID i indekset, der peger tilbage på den, og indekset har ikke
+        // andre pladser end dem
+        size_t indexed = 0;
+        for (size_t i = 0; i < header.m_id_index_size; ++i) {
+            if (id_index[i] != no_slot) {
+                if (id_index[i] >= n || ids[id_index[i]] != i + 1) {
+                    throw invalid("ID-indeks");
+                }
+                ++indexed;
+            }
+        }
+        if (indexed != n || header.m_next_id <= header.m_id_index_size) {
+            throw invalid("ID-indeks");
+        }
+        if (std::any_of(place_ids, place_ids + n, [&](place_id_t id) { return id >= header.m_places; })) {
+            throw invalid("sted uden for stedtabellen");
+        }
+
+        store.m_ids = cow_vector_t<uint64_t>::view(owner, ids, n);
+        store.m_timestamps = cow_vector_t<int64_t>::view(owner, timestamps, n);
+        store.m_place_ids = cow_vector_t<place_id_t>::view(owner, place_ids, n);
+        store.m_temperatures = cow_vector_t<double>::view(owner, section_at<double>(base, layout.m_temperatures), n);
+        store.m_humidities = cow_vector_t<int>::view(owner, section_at<int>(base, layout.m_humidities), n);
+        store.m_id_index = cow_vector_t<slot_t>::view(owner, id_index, header.m_id_index_size);
+
+        const auto* places = section_at<snapshot_place_t>(base, layout.m_places);
+        const char* names = base + layout.m_names;
+        auto dictionary = std::make_shared<place_dictionary_t>();
+        for (size_t place = 0; place < header.m_places; ++place) {
+            const snapshot_place_t& entry = places[place];
+            if (entry.m_name_offset > header.m_names_size ||
+                entry.m_name_size > header.m_names_size - entry.m_name_offset) {
+                throw invalid("stednavn uden for filen");
+            }
+            dictionary->intern({std::string(names + entry.m_name_offset, entry.m_name_size), entry.m_lat, entry.m_lon});
+        }
+        if (dictionary->size() != header.m_places) {
+            throw invalid("dublerede steder");
+        }
+        store.m_places = std::move(dictionary);
+
+        const auto* counts = section_at<uint64_t>(base, layout.m_place_counts);
+        const auto* slots = section_at<uint64_t>(base, layout.m_place_slots);
+        uint64_t counted = 0; // Hver plads står i netop ét stedsindeks
+        for (size_t place = 0; place < header.m_places; ++place) {
+            if (counts[place] > n - counted) {
+                throw invalid("stedsindeks");
+            }
+            counted += counts[place];
+        }
+        if (counted != n) {
+            throw invalid("stedsindeks");
+        }
+        // Stigende pladser med netop dette sted; sammen med antallene giver
+        // det hver plads præcis én gang
+        for (size_t place = 0, i = 0; place < header.m_places; ++place) {
+            for (const size_t end = i + counts[place]; i < end; ++i) {
+                if (slots[i] >= n || place_ids[slots[i]] != place || (i + 1 < end && slots[i] >= slots[i + 1])) {
+                    throw invalid("stedsindeks");
+                }
+            }
+        }
+        for (size_t place = 0; place < header.m_places; ++place) {
+            store.m_place_index.push_back(std::make_shared<place_slots_t>(
+                place_slots_t::from_sorted(counts[place], [&](size_t i) { return static_cast<slot_t>(slots[i]); })));
+            slots += counts[place];
+        }
+
+        const auto* times = section_at<snapshot_time_entry_t>(base, layout.m_time_index);
+        // Stigende (tidspunkt, plads) med kolonnens tidspunkt; så står hver
+        // plads der også præcis én gang
+        for (size_t i = 0; i < n; ++i) {
+            const snapshot_time_entry_t& entry = times[i];
+            if (entry.m_slot >= n || timestamps[entry.m_slot] != entry.m_minutes ||
+                (i > 0 && !(time_entry_t{times[i - 1].m_minutes, times[i - 1].m_slot} <
+                            time_entry_t{entry.m_minutes, entry.m_slot}))) {
+                throw invalid("tidsindeks");
+            }
+        }
+        store.m_time_index = cow_sorted_index_t<time_entry_t>::from_sorted(n, [&](size_t i) {
+            return time_entry_t{times[i].m_minutes, static_cast<slot_t>(times[i].m_slot)};
+        });
+
+        store.m_next_id = header.m_next_id;
+        store.m_version = header.m_version;
+        log_position = header.m_log_position;
+        return store;
+    }
+
+    // Bygger et lager af mange poster på én gang (til indlæsning). Samme
+    // regler som insert plus afvisning af dublerede tidspunkter som ved
+    // POST, men kolonnerne fyldes i ét stræk og indeksene sorteres én gang
+    // i stedet for at kopiere et blad pr. post. Afviste poster springes
+    // over og noteres i rejected som (plads i records, årsag).
+    static weather_store_t bulk_load(
+        std::vector<weathercast_t> records, std::vector<std::pair<size_t, std::string>>& rejected)
+    {
+        weather_store_t store;
+        const size_t n = records.size();
+        std::vector<uint64_t> ids;
+        std::vector<int64_t> timestamps;
+        std::vector<place_id_t> place_ids;
+        std::vector<double> temperatures;
+        std::vector<int> humidities;
+        std::vector<slot_t> id_index;
+        ids.reserve(n);
+        timestamps.reserve(n);
+        place_ids.reserve(n);
+        temperatures.reserve(n);
+        humidities.reserve(n);
+
+        auto places = std::make_shared<place_dictionary_t>();
+        std::unordered_set<int64_t> used_times;
+        used_times.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            weathercast_t& record = records[i];
+            uint64_t id = store.m_next_id;
+            if (!record.m_id.empty()) {
+                const auto parsed = parse_id(record.m_id);
+                if (!parsed || *parsed == 0) {
+                    rejected.emplace_back(i, "Ugyldigt ID: " + record.m_id);
+                    continue;
+                }
+                id = *parsed;
+                if (id <= id_index.size() && id_index[id - 1] != no_slot) {
+                    rejected.emplace_back(i, "ID findes allerede: " + record.m_id);
+                    continue;
+                }
+                if (id > id_index.size() + max_id_gap) {
+                    rejected.emplace_back(i, "ID ligger for langt fra de øvrige: " + record.m_id);
+                    continue;
+                }
+            }
+            if (!used_times.insert(record.m_dateTime.m_minutes).second) {
+                rejected.emplace_back(i, "En vejrudsigt med dette tidspunkt eksisterer allerede.");
+                continue;
+            }
+            store.m_next_id = std::max(store.m_next_id, id + 1);
+
+            if (id_index.size() < id) {
+                id_index.resize(id, no_slot);
+            }
+            id_index[id - 1] = ids.size();
+            ids.push_back(id);
+            timestamps.push_back(record.m_dateTime.m_minutes);
+            place_ids.push_back(places->intern(record.m_place));
+            temperatures.push_back(record.m_temperature);
+            humidities.push_back(record.m_humidity);
+        }
+        records.clear();
+        records.shrink_to_fit();
+
+        const size_t count = ids.size();
+        std::vector<time_entry_t> times(count);
+        std::vector<std::vector<slot_t>> slots_by_place(places->size());
+        for (slot_t slot = 0; slot < count; ++slot) {
+            times[slot] = {timestamps[slot], slot};
+            slots_by_place[place_ids[slot]].push_back(slot); // Allerede sorteret
+        }
+        std::sort(times.begin(), times.end());
+        store.m_time_index = cow_sorted_index_t<time_entry_t>::from_sorted(
+            count, [&](size_t i) { return times[i]; });
+        for (const auto& slots : slots_by_place) {
+            store.m_place_index.push_back(std::make_shared<place_slots_t>(
+                place_slots_t::from_sorted(slots.size(), [&](size_t i) { return slots[i]; })));
+        }
+
+        store.m_ids = column_from(std::move(ids));
+        store.m_timestamps = column_from(std::move(timestamps));
+        store.m_place_ids = column_from(std::move(place_ids));
+        store.m_temperatures = column_from(std::move(temperatures));
+        store.m_humidities = column_from(std::move(humidities));
+        store.m_id_index = column_from(std::move(id_index));
+        store.m_places = std::move(places);
+        store.m_version = count;
+        return store;
+    }
+
+private:
+    using time_entry_t = std::pair<int64_t, slot_t>;
+    using place_slots_t = cow_sorted_index_t<slot_t>;
+
+    static constexpr slot_t no_slot = std::numeric_limits<slot_t>::max();
+
+    // Snapshot-format: en header efterfulgt af afsnittene i
+    // snapshot_layout_t, hvert startende på en 8-byte-grænse. Formatet
+    // tælles op, når layoutet ændres; format 1 havde magic "NGKSNAP1" og
+    // intet formatfelt eller version.
+    static constexpr char snapshot_magic[8] = {'N', 'G', 'K', 'S', 'N', 'A', 'P', '\0'};
+    static constexpr uint64_t snapshot_format = 2;
+
+    struct snapshot_header_t
+    {
+        char m_magic[8];
+        uint64_t m_format;
+        uint64_t m_records;
+        uint64_t m_places;
+        uint64_t m_id_index_size;
+        uint64_t m_next_id;
+        uint64_t m_log_position;
+        uint64_t m_names_size;
+        uint64_t m_version; // weather_store_t::version()
+    };
+
+    struct snapshot_place_t
+    {
+        double m_lat;
+        double m_lon;
+        uint64_t m_name_offset; // I afsnittet med navne
+        uint64_t m_name_size;
+    };
+
+    struct snapshot_time_entry_t
+    {
+        int64_t m_minutes;
+        uint64_t m_slot;
+    };
+
+    static_assert(sizeof(slot_t) == 8 && sizeof(int) == 4 && sizeof(double) == 8,
+                  "Snapshot-formatet forudsætter 64-bit pladser og 32-bit int");
+
+    // Kolonne hvis blade peger ind i values, som kolonnen overtager
+    template <typename T>
+    static cow_vector_t<T> column_from(std::vector<T> values)
+    {
+        const auto owner = std::make_shared<const std::vector<T>>(std::move(values));
+        return cow_vector_t<T>::view(owner, owner->data(), owner->size());
+    }
+
+    template <typename T>
+    static const T* section_at(const char* base, size_t offset)
+    {
+        return reinterpret_cast<const T*>(base + offset);
+    }
+
+    // Start på hvert afsnit i filen, udregnet ud fra headeren. m_overflow
+    // er sat, hvis antallene i headeren giver en fil større end size_t
+    // kan rumme (en ødelagt header); så er starterne meningsløse.
+    struct snapshot_layout_t
+    {
+        size_t m_ids, m_timestamps, m_place_ids, m_temperatures, m_humidities, m_id_index;
+        size_t m_places, m_place_counts, m_place_slots, m_time_index, m_names, m_end;
+        bool m_overflow = false;
+
+        explicit snapshot_layout_t(const snapshot_header_t& header)
+        {
+            constexpr size_t limit = std::numeric_limits<size_t>::max() - 7;
+            size_t at = sizeof header;
+            auto section = [&](uint64_t count, size_t item_size) {
+                const size_t start = at;
+                if (m_overflow || count > (limit - at) / item_size) {
+                    m_overflow = true;
+                    return start;
+                }
+                at = (at + count * item_size + 7) & ~size_t{7};
+                return start;
+            };
+            m_ids = section(header.m_records, sizeof(uint64_t));
+            m_timestamps = section(header.m_records, sizeof(int64_t));
+            m_place_ids = section(header.m_records, sizeof(place_id_t));
+            m_temperatures = section(header.m_records, sizeof(double));
+            m_humidities = section(header.m_records, sizeof(int));
+            m_id_index = section(header.m_id_index_size, sizeof(slot_t));
+            m_places = section(header.m_places, sizeof(snapshot_place_t));
+            m_place_counts = section(header.m_places, sizeof(uint64_t));
+            m_place_slots = section(header.m_records, sizeof(uint64_t));
+            m_time_index = section(header.m_records, sizeof(snapshot_time_entry_t));
+            m_names = section(header.m_names_size, 1);
+            m_end = at;
+        }
+    };
+
+    // Kolonner, én indgang pr. plads
+    cow_vector_t<uint64_t> m_ids;
+    cow_vector_t<int64_t> m_timestamps; // dateTime_t::m_minutes
+    cow_vector_t<place_id_t> m_place_ids;
+    cow_vector_t<double> m_temperatures;
+    cow_vector_t<int> m_humidities;
+
+    // Ordbogen kopieres kun, når et nyt sted kommer til, og kun hvis den
+    // deles med en anden kopi af lageret
+    std::shared_ptr<place_dictionary_t> m_places = std::make_shared<place_dictionary_t>();
+
+    cow_vector_t<slot_t> m_id_index; // ID - 1 -> plads, no_slot for huller
+    cow_sorted_index_t<time_entry_t> m_time_index; // Sorteret på (tidspunkt, plads)
+    // Pr. steds-ID. Et stedsindeks ændres på stedet, når hverken det eller
+    // bladet det står i deles med en anden kopi af lageret.
+    cow_vector_t<std::shared_ptr<place_slots_t>> m_place_index;
+    uint64_t m_next_id = 1;
+    uint64_t m_version = 0;
+
+    place_id_t intern_place(const place_t& place)
+    {
+        if (const auto known = m_places->find(place)) {
+            return *known;
+        }
+        if (!unshared(m_places)) {
+            m_places = std::make_shared<place_dictionary_t>(*m_places);
+        }
+        return m_places->intern(place);
+    }
+
+    // Stedsindekset for place_id, gjort skrivbart
+    place_slots_t& writable_place_slots(place_id_t place_id)
+    {
+        while (m_place_index.size() <= place_id) {
+            m_place_index.push_back(std::make_shared<place_slots_t>());
+        }
+        // Bladet gøres skrivbart først; kopieres det, deles indekserne i det
+        auto& slots = *m_place_index.writable(place_id);
+        if (!unshared(slots)) {
+            slots = std::make_shared<place_slots_t>(*slots);
+        }
+        return *slots;
+    }
+
+    // Tildeler ID og tilføjer posten til kolonnerne og ID-indekset, men
+    // ikke til tids- og stedsindeksene. Kaster før noget ændres, hvis
+    // posten har et ugyldigt ID.
+    slot_t append(weathercast_t& record)
+    {
+        uint64_t id = 0;
+        if (record.m_id.empty()) {
+            id = m_next_id++;
+            record.m_id = std::to_string(id);
+        } else {
+            const auto parsed = parse_id(record.m_id);
+            if (!parsed || *parsed == 0) {
+                throw std::invalid_argument("Ugyldigt ID: " + record.m_id);
+            }
+            id = *parsed;
+            if (slot_of(id)) {
+                throw std::invalid_argument("ID findes allerede: " + record.m_id);
+            }
+            if (id > m_id_index.size() + max_id_gap) {
+                throw std::invalid_argument("ID ligger for langt fra de øvrige: " + record.m_id);
+            }
+            m_next_id = std::max(m_next_id, id + 1); // Sikre unikt ID
+        }
+
+        const slot_t slot = size();
+        const place_id_t place_id = intern_place(record.m_place);
+        while (m_id_index.size() < id) {
+            m_id_index.push_back(no_slot);
+        }
+        m_id_index.set(id - 1, slot);
+
+        m_ids.push_back(id);
+        m_timestamps.push_back(record.m_dateTime.m_minutes);
+        m_place_ids.push_back(place_id);
+        m_temperatures.push_back(record.m_temperature);
+        m_humidities.push_back(record.m_humidity);
+        ++m_version;
+        return slot;
+    }
+
+    void index_place(place_id_t place_id, slot_t slot)
+    {
+        writable_place_slots(place_id).insert(slot);
+    }
+
+    void unindex_place(place_id_t place_id, slot_t slot)
+    {
+        writable_place_slots(place_id).erase(slot);
+    }
+};
+
+// Deler lageret mellem trådene efter RCU-princippet: læsere henter den
+// aktuelle, uforanderlige version og læser fra den uden at blokere.
+// Skrivere serialiseres, ændrer en kopi (der deler alt uændret data med
+// den gamle version) og udgiver den bagefter. En gammel version lever,
+// så længe en læser stadig holder den.
+class shared_weather_store_t
+{
+public:
+    using snapshot_t = std::shared_ptr<const weather_store_t>;
+
+    explicit shared_weather_store_t(weather_store_t initial)
+        : m_current{std::make_shared<const weather_store_t>(std::move(initial))}
+    {}
+
+    shared_weather_store_t(const shared_weather_store_t &) = delete;
+    shared_weather_store_t(shared_weather_store_t &&) = delete;
+
+    // Den aktuelle version. Koster kun en optælling af referencen.
+    snapshot_t snapshot() const
+    {
+        return std::atomic_load(&m_current);
+    }
+
+    // Kører writer på en kopi af den aktuelle version og udgiver kopien,
+    // hvis writer ændrede noget. Returnerer det writer returnerer.
+    template <typename F>
+    std::invoke_result_t<F, weather_store_t&> write(F&& writer)
+    {
+        return write(std::forward<F>(writer), [] {});
+    }
+
+    // Som write, men kalder published efter udgivelsen og stadig under
+    // skrivelåsen, så det writer har forberedt ved siden af lageret, kan
+    // udgives i lagerets rækkefølge uden at blive set før den version, det
+    // hører til. published kaldes ikke, hvis writer kaster.
+    template <typename F, typename P>
+    std::invoke_result_t<F, weather_store_t&> write(F&& writer, P&& published)
+    {
+        std::lock_guard lock{m_write_lock};
+        auto next = std::make_shared<weather_store_t>(*m_current);
+
+        if constexpr (std::is_void_v<std::invoke_result_t<F, weather_store_t&>>) {
+            writer(*next);
+            publish(std::move(next));
+            published();
+        } else {
+            auto result = writer(*next);
+            publish(std::move(next));
+            published();
+            return result;
+        }
+    }
+
+    // Kalder f med den aktuelle version, mens skrivere holdes tilbage, så
+    // f kan aflæse andet der hører til netop den version. f skal være kort.
+    template <typename F>
+    std::invoke_result_t<F, const snapshot_t&> read_locked(F&& f)
+    {
+        std::lock_guard lock{m_write_lock};
+        return f(m_current);
+    }
+
+private:
+    snapshot_t m_current; // Læses og skrives kun med atomic_load/atomic_store
+    std::mutex m_write_lock;
+
+    void publish(std::shared_ptr<weather_store_t> next)
+    {
+        if (next->version() != m_current->version()) {
+            std::atomic_store(&m_current, snapshot_t{std::move(next)});
+        }
+    }
+};
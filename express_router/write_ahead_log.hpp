@@ -0,0 +1,491 @@
+// Write-ahead-loggen, der gør ændringer i lageret holdbare mellem
+// snapshots. Bruges af serveren (main.cpp).
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "weather_store.hpp"
+
+// Append-only log over ændringer i lageret, så data overlever en genstart.
+// Hver post skrives som [længde u32][kontrolsum u32][indhold] i maskinens
+// byte-rækkefølge og starter med sit løbenummer (LSN), der fortsætter på
+// tværs af genstarter og tømning af loggen. Skrivninger samles i en
+// buffer, og en baggrundstråd skriver og fdatasync'er hele bufferen højst
+// commit_interval efter den første ventende post (group commit), så én
+// fsync dækker mange forespørgsler.
+class write_ahead_log_t
+{
+public:
+    using lsn_t = uint64_t; // Løbenummer for en post i loggen
+    using callback_t = std::function<void(bool durable)>;
+
+    // Åbner (eller opretter) loggen og afspiller den ind i store. Poster
+    // til og med covered er allerede i store (fra et snapshot) og springes
+    // over. En ufuldstændig post til sidst (fx efter et strømsvigt) skæres væk.
+    write_ahead_log_t(
+        const std::string& path,
+        std::chrono::milliseconds commit_interval,
+        weather_store_t& store,
+        lsn_t covered = 0)
+        : m_path(path)
+        , m_commit_interval(commit_interval)
+        , m_appended(covered)
+    {
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            throw std::runtime_error("Kan ikke åbne loggen " + path + ": " + std::strerror(errno));
+        }
+        try {
+            replay(store, covered);
+            m_synced = m_appended;
+        } catch (...) {
+            ::close(m_fd);
+            throw;
+        }
+        m_committer = std::thread([this] { run_committer(); });
+    }
+
+    write_ahead_log_t(const write_ahead_log_t&) = delete;
+    write_ahead_log_t& operator=(const write_ahead_log_t&) = delete;
+
+    ~write_ahead_log_t()
+    {
+        {
+            std::lock_guard lock{m_lock};
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_committer.join(); // Skriver resten inden tråden stopper
+        ::close(m_fd);
+    }
+
+    size_t replayed() const { return m_replayed; }
+
+    // LSN for den senest loggede post
+    lsn_t last_lsn()
+    {
+        std::lock_guard lock{m_lock};
+        return m_appended;
+    }
+
+    // Tømmer loggen, når et snapshot dækker alt i den. Må kun kaldes, når
+    // ingen skriver til lageret; LSN fortsætter hvor den slap.
+    void clear()
+    {
+        sync();
+        std::lock_guard file_lock{m_file_lock};
+        if (::ftruncate(m_fd, 0) != 0 || ::lseek(m_fd, 0, SEEK_SET) < 0 || ::fdatasync(m_fd) != 0) {
+            throw std::runtime_error(std::string("Kan ikke tømme loggen: ") + std::strerror(errno));
+        }
+    }
+
+    // Fjerner posterne til og med covered, som et snapshot nu dækker, mens
+    // der fortsat skrives. Resten kopieres til en ny fil og synkroniseres
+    // uden at holde filen låst; det, der er kommet til imens, kopieres i en
+    // ny runde. Først når den nye fil har det hele, låses filen, og den
+    // nye omdøbes over den gamle og tager dens plads, så skrivninger kun
+    // venter på omdøbningen. Snapshottet skal være på disken (inkl. sin
+    // mappe) før kaldet.
+    void compact(lsn_t covered)
+    {
+        off_t copied_to = end_of_log();
+        const off_t cut = first_after(covered, copied_to);
+        if (cut == 0) {
+            return; // Intet at fjerne
+        }
+
+        const std::string temp_path = m_path + ".tmp";
+        const int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Kan ikke oprette " + temp_path + ": " + std::strerror(errno));
+        }
+        try {
+            copy_range(m_fd, cut, copied_to, fd);
+            sync_copy(fd);
+            for (size_t round = 1;; ++round) {
+                std::unique_lock file_lock{m_file_lock};
+                const off_t end = ::lseek(m_fd, 0, SEEK_END);
+                if (end < 0) {
+                    throw std::runtime_error(std::string("Kan ikke læse loggen: ") + std::strerror(errno));
+                }
+                if (end != copied_to && round >= max_compact_rounds) {
+                    // Skrives der hurtigere, end der kopieres, tages resten
+                    // med filen låst, så kopieringen slutter
+                    copy_range(m_fd, copied_to, end, fd);
+                    sync_copy(fd);
+                    copied_to = end;
+                }
+                if (end == copied_to) {
+                    if (::rename(temp_path.c_str(), m_path.c_str()) != 0) {
+                        const int error = errno;
+                        throw std::runtime_error("Kan ikke erstatte loggen: " + std::string(std::strerror(error)));
+                    }
+                    ::close(m_fd);
+                    m_fd = fd; // Står allerede ved slutningen
+                    break;
+                }
+                file_lock.unlock();
+                copy_range(m_fd, copied_to, end, fd);
+                sync_copy(fd);
+                copied_to = end;
+            }
+        } catch (...) {
+            ::close(fd);
+            ::unlink(temp_path.c_str());
+            throw;
+        }
+        sync_parent_directory(m_path); // Ellers kan den gamle log komme tilbage efter et nedbrud
+    }
+
+    // log_insert og log_update skal kaldes under lagerets skrivelås, så
+    // rækkefølgen i loggen er den samme som i lageret.
+    lsn_t log_insert(const weathercast_t& record) { return append(op_insert, record); }
+    lsn_t log_update(const weathercast_t& record) { return append(op_update, record); }
+
+    // Kalder done, når alle poster til og med lsn er skrevet til disken.
+    // done kaldes enten med det samme eller fra baggrundstråden.
+    void when_durable(lsn_t lsn, callback_t done)
+    {
+        std::unique_lock lock{m_lock};
+        if (lsn <= m_synced) {
+            const bool durable = !m_failed;
+            lock.unlock();
+            done(durable);
+            return;
+        }
+        m_waiting.emplace(lsn, std::move(done));
+    }
+
+    // Om en skrivning til loggen er slået fejl. Herefter kan intet mere
+    // gøres holdbart, så der bør ikke tages imod flere ændringer.
+    bool failed()
+    {
+        std::lock_guard lock{m_lock};
+        return m_failed;
+    }
+
+    // Venter til alt hidtil logget er på disken
+    bool sync()
+    {
+        std::unique_lock lock{m_lock};
+        const lsn_t target = m_appended;
+        m_flush_now = true;
+        m_wake.notify_all();
+        m_synced_cond.wait(lock, [&] { return m_synced >= target; });
+        return !m_failed;
+    }
+
+private:
+    enum op_t : uint8_t { op_insert = 1, op_update = 2 };
+
+    // Runder med kopiering uden lås i compact, før resten kopieres med lås
+    static constexpr size_t max_compact_rounds = 8;
+
+    const std::string m_path;
+    int m_fd = -1;
+    std::mutex m_file_lock; // Holdes mens m_fd skrives, synkroniseres eller udskiftes
+    const std::chrono::milliseconds m_commit_interval;
+    size_t m_replayed = 0;
+
+    std::mutex m_lock; // Beskytter alt herunder
+    std::condition_variable m_wake;
+    std::condition_variable m_synced_cond;
+    std::string m_pending; // Kodede poster der endnu ikke er skrevet
+    std::chrono::steady_clock::time_point m_first_pending;
+    lsn_t m_appended; // Senest tildelte LSN
+    lsn_t m_synced = 0;
+    std::multimap<lsn_t, callback_t> m_waiting;
+    bool m_flush_now = false;
+    bool m_failed = false; // En skrivning er slået fejl; intet er sikkert herefter
+    bool m_stop = false;
+
+    std::thread m_committer;
+
+    lsn_t append(op_t op, const weathercast_t& record)
+    {
+        std::string body;
+        put(body, op);
+        put(body, *weather_store_t::parse_id(record.m_id));
+        put(body, record.m_dateTime.m_minutes);
+        put(body, static_cast<uint32_t>(record.m_place.m_name.size()));
+        body += record.m_place.m_name;
+        put(body, record.m_place.m_lat);
+        put(body, record.m_place.m_lon);
+        put(body, record.m_temperature);
+        put(body, static_cast<int32_t>(record.m_humidity));
+
+        std::lock_guard lock{m_lock};
+        if (m_pending.empty()) {
+            m_first_pending = std::chrono::steady_clock::now();
+            m_wake.notify_all();
+        }
+        const lsn_t lsn = ++m_appended;
+        std::string payload;
+        put(payload, lsn);
+        payload += body;
+        put(m_pending, static_cast<uint32_t>(payload.size()));
+        put(m_pending, checksum(payload));
+        m_pending += payload;
+        return lsn;
+    }
+
+    void run_committer()
+    {
+        std::unique_lock lock{m_lock};
+        for (;;) {
+            m_wake.wait(lock, [&] { return m_stop || m_flush_now || !m_pending.empty(); });
+            if (m_stop && m_pending.empty()) {
+                return;
+            }
+            // Saml flere poster op, men højst commit_interval efter den første
+            m_wake.wait_until(lock, m_first_pending + m_commit_interval,
+                [&] { return m_stop || m_flush_now; });
+            m_flush_now = false;
+
+            std::string batch;
+            batch.swap(m_pending);
+            const lsn_t last = m_appended;
+
+            lock.unlock();
+            int error = 0; // Gemmes straks; errno kan ændres, når låsen slippes
+            {
+                std::lock_guard file_lock{m_file_lock};
+                if (!write_all(batch) || ::fdatasync(m_fd) != 0) {
+                    error = errno;
+                }
+            }
+            const bool ok = error == 0;
+            if (!ok) {
+                std::cerr << "Fejl ved skrivning til loggen: " << std::strerror(error) << std::endl;
+            }
+            lock.lock();
+
+            m_failed = m_failed || !ok;
+            m_synced = last;
+            std::vector<callback_t> ready;
+            const auto end = m_waiting.upper_bound(last);
+            for (auto it = m_waiting.begin(); it != end; ++it) {
+                ready.push_back(std::move(it->second));
+            }
+            m_waiting.erase(m_waiting.begin(), end);
+            const bool durable = !m_failed;
+            m_synced_cond.notify_all();
+
+            lock.unlock();
+            for (auto& done : ready) {
+                done(durable);
+            }
+            lock.lock();
+        }
+    }
+
+    bool write_all(const std::string& data)
+    {
+        size_t written = 0;
+        while (written < data.size()) {
+            const auto n = ::write(m_fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Loggens nuværende længde
+    off_t end_of_log()
+    {
+        std::lock_guard file_lock{m_file_lock};
+        const off_t end = ::lseek(m_fd, 0, SEEK_END);
+        if (end < 0) {
+            throw std::runtime_error(std::string("Kan ikke læse loggen: ") + std::strerror(errno));
+        }
+        return end;
+    }
+
+    static void sync_copy(int fd)
+    {
+        if (::fdatasync(fd) != 0) {
+            throw std::runtime_error(std::string("Kan ikke skrive kopien af loggen: ") + std::strerror(errno));
+        }
+    }
+
+    // Position for den første post med LSN efter covered, blandt posterne
+    // før end. Posterne er hele, da en beskadiget hale fjernes ved åbning.
+    off_t first_after(lsn_t covered, off_t end) const
+    {
+        off_t at = 0;
+        while (at < end) {
+            char head[sizeof(uint32_t) * 2 + sizeof(lsn_t)];
+            if (::pread(m_fd, head, sizeof head, at) != static_cast<ssize_t>(sizeof head)) {
+                throw std::runtime_error(std::string("Kan ikke læse loggen: ") + std::strerror(errno));
+            }
+            uint32_t size = 0;
+            lsn_t lsn = 0;
+            std::memcpy(&size, head, sizeof size);
+            std::memcpy(&lsn, head + sizeof(uint32_t) * 2, sizeof lsn);
+            if (lsn > covered) {
+                break;
+            }
+            at += static_cast<off_t>(sizeof(uint32_t) * 2 + size);
+        }
+        return std::min(at, end);
+    }
+
+    // Kopierer bytes [from, to) fra in til slutningen af out
+    static void copy_range(int in, off_t from, off_t to, int out)
+    {
+        char buffer[1 << 16];
+        while (from < to) {
+            const auto n = ::pread(in, buffer, static_cast<size_t>(std::min<off_t>(sizeof buffer, to - from)), from);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error(std::string("Kan ikke kopiere loggen: ") + std::strerror(errno));
+            }
+            for (ssize_t written = 0; written < n;) {
+                const auto w = ::write(out, buffer + written, static_cast<size_t>(n - written));
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w < 0) {
+                    throw std::runtime_error(std::string("Kan ikke kopiere loggen: ") + std::strerror(errno));
+                }
+                written += w;
+            }
+            from += n;
+        }
+    }
+
+    void replay(weather_store_t& store, lsn_t covered)
+    {
+        std::string data;
+        char buffer[1 << 16];
+        for (;;) {
+            const auto n = ::read(m_fd, buffer, sizeof buffer);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw std::runtime_error(std::string("Kan ikke læse loggen: ") + std::strerror(errno));
+            }
+            if (n == 0) {
+                break;
+            }
+            data.append(buffer, static_cast<size_t>(n));
+        }
+
+        std::string_view rest{data};
+        for (;;) {
+            uint32_t size = 0;
+            uint32_t sum = 0;
+            std::string_view frame = rest;
+            if (!get(frame, size) || !get(frame, sum) || frame.size() < size) {
+                break;
+            }
+            std::string_view payload = frame.substr(0, size);
+            if (checksum(payload) != sum) {
+                break;
+            }
+
+            lsn_t lsn = 0;
+            uint8_t op = 0;
+            uint64_t id = 0;
+            int64_t minutes = 0;
+            uint32_t name_size = 0;
+            weathercast_t record;
+            int32_t humidity = 0;
+            if (!get(payload, lsn) || !get(payload, op) || !get(payload, id) || !get(payload, minutes) ||
+                !get(payload, name_size) || payload.size() < name_size) {
+                break;
+            }
+            record.m_place.m_name = std::string(payload.substr(0, name_size));
+            payload.remove_prefix(name_size);
+            if (!get(payload, record.m_place.m_lat) || !get(payload, record.m_place.m_lon) ||
+                !get(payload, record.m_temperature) || !get(payload, humidity)) {
+                break;
+            }
+            record.m_id = std::to_string(id);
+            record.m_dateTime = dateTime_t{minutes};
+            record.m_humidity = humidity;
+
+            if (op != op_insert && op != op_update) {
+                break;
+            }
+            if (lsn > covered) {
+                if (op == op_insert) {
+                    store.insert(std::move(record));
+                } else {
+                    store.update(id, record);
+                }
+                ++m_replayed;
+            }
+            m_appended = std::max(m_appended, lsn);
+            rest = frame.substr(size);
+        }
+
+        // Skær en ufuldstændig eller beskadiget hale væk, så nye poster
+        // ikke havner efter den
+        const auto good = static_cast<off_t>(data.size() - rest.size());
+        if (!rest.empty()) {
+            std::cerr << "Loggen er beskadiget efter " << m_replayed << " poster; resten kasseres" << std::endl;
+            if (::ftruncate(m_fd, good) != 0) {
+                throw std::runtime_error(std::string("Kan ikke afkorte loggen: ") + std::strerror(errno));
+            }
+        }
+        if (::lseek(m_fd, good, SEEK_SET) < 0) {
+            throw std::runtime_error(std::string("Kan ikke søge i loggen: ") + std::strerror(errno));
+        }
+    }
+
+    template <typename T>
+    static void put(std::string& out, T value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    template <typename T>
+    static bool get(std::string_view& in, T& value)
+    {
+        if (in.size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    // FNV-1a; nok til at fange en halvt skrevet post
+    static uint32_t checksum(std::string_view data)
+    {
+        uint32_t hash = 2166136261u;
+        for (const char c : data) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return hash;
+    }
+};